@@ -0,0 +1,220 @@
+#include "checks.h"
+#include "..\GameEngine\Graphics\boundsTree.h"
+#include "..\GameEngine\Graphics\cullingSet.h"
+#include <../glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+//same margin as the scene tree in the game
+#define CHECK_MARGIN 1.0f
+
+struct Leaf
+{
+	glm::vec3 low, high;
+	int proxy;
+};
+
+//tree sized boxes at a fixed density, the square grows with the count
+static glm::vec3 randomCenter(unsigned int& seed, float half)
+{
+	return glm::vec3(checkRandom(seed, -half, half), checkRandom(seed, -20.0f, 20.0f), checkRandom(seed, -half, half));
+}
+
+static void place(Leaf& leaf, const glm::vec3& center, unsigned int& seed)
+{
+	glm::vec3 extent(checkRandom(seed, 0.5f, 5.0f), checkRandom(seed, 2.0f, 20.0f), checkRandom(seed, 0.5f, 5.0f));
+	leaf.low = center - extent;
+	leaf.high = center + extent;
+}
+
+static float halfSide(unsigned int count)
+{
+	//about one box per 20x20 units
+	return glm::sqrt((float)count) * 10.0f;
+}
+
+static Frustum view(const glm::vec3& eye, float yaw, float fov, float farPlane)
+{
+	glm::mat4 projection = glm::perspective(fov, 16.0f / 9.0f, 0.1f, farPlane);
+	glm::mat4 look = glm::lookAt(eye, eye + glm::vec3(glm::cos(yaw), -0.05f, glm::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+	return Frustum(projection * look);
+}
+
+//the query split into parts as the game does, returns the nodes it visited
+static unsigned int queryVisited(BoundsTree& tree, const Frustum& frustum, unsigned int parts, std::vector<unsigned int>& visible)
+{
+	std::vector<BoundsSubtree> subtrees;
+	tree.split(frustum, parts, subtrees);
+
+	BoundsQueryCounts counts;
+	visible.clear();
+	for (unsigned int i = 0; i < subtrees.size(); i++)
+		tree.query(frustum, subtrees[i], visible, counts);
+	return counts.visited;
+}
+
+//about 300k leaves after random moves and removals: every leaf the per-box test keeps
+//must come back, whole and in parts, and the tree must stay logarithmically high
+static void checkQueries()
+{
+	const unsigned int count = 300000;
+	float half = halfSide(count);
+	unsigned int seed = 0x3c6ef372u;
+
+	BoundsTree tree;
+	std::vector<Leaf> leaves(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		place(leaves[i], randomCenter(seed, half), seed);
+		leaves[i].proxy = tree.insert(leaves[i].low, leaves[i].high, i, CHECK_MARGIN);
+	}
+
+	//small steps mostly stay in the fat leaf, jumps always reinsert
+	unsigned int moved = 0;
+	for (unsigned int i = 0; i < count / 4; i++)
+	{
+		Leaf& leaf = leaves[checkRandom(seed) % count];
+		if (leaf.proxy == BOUNDS_TREE_NULL)
+			continue;
+		glm::vec3 center = (leaf.low + leaf.high) * 0.5f;
+		center = i % 2 == 0 ? center + glm::vec3(checkRandom(seed, -0.8f, 0.8f), 0.0f, checkRandom(seed, -0.8f, 0.8f)) : randomCenter(seed, half);
+		place(leaf, center, seed);
+		moved += tree.update(leaf.proxy, leaf.low, leaf.high, CHECK_MARGIN) ? 1 : 0;
+	}
+	unsigned int removed = 0;
+	for (unsigned int i = 0; i < count / 10; i++)
+	{
+		Leaf& leaf = leaves[checkRandom(seed) % count];
+		if (leaf.proxy == BOUNDS_TREE_NULL)
+			continue;
+		tree.remove(leaf.proxy);
+		leaf.proxy = BOUNDS_TREE_NULL;
+		removed++;
+	}
+
+	unsigned int leafCount = tree.getLeafCount();
+	int bound = 2 * (int)glm::ceil(glm::log2((float)leafCount));
+	std::cout << "  " << leafCount << " leaves after " << moved << " reinserting moves and " << removed
+		<< " removals, height " << tree.getHeight() << " (bound " << bound << ")" << std::endl;
+	CHECK(leafCount == count - removed);
+	CHECK(tree.getHeight() <= bound);
+
+	unsigned int missing = 0, stale = 0, partMismatches = 0;
+	for (int v = 0; v < 12; v++)
+	{
+		glm::vec3 eye(checkRandom(seed, -half, half), 4.0f, checkRandom(seed, -half, half));
+		bool narrow = v % 2 == 1;
+		Frustum frustum = view(eye, v * 0.5f, narrow ? 10.0f : 90.0f, narrow ? 300.0f : 10000.0f);
+
+		std::vector<unsigned int> whole;
+		tree.query(frustum, whole);
+		std::sort(whole.begin(), whole.end());
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			bool returned = std::binary_search(whole.begin(), whole.end(), i);
+			if (leaves[i].proxy == BOUNDS_TREE_NULL)
+				stale += returned ? 1 : 0;
+			else if (frustum.intersects(leaves[i].low, leaves[i].high) && !returned)
+				missing++;
+		}
+
+		std::vector<unsigned int> parts;
+		for (unsigned int n = 4; n <= 64; n *= 4)
+		{
+			queryVisited(tree, frustum, n, parts);
+			std::sort(parts.begin(), parts.end());
+			partMismatches += parts == whole ? 0 : 1;
+		}
+	}
+	std::cout << "  12 views: " << missing << " visible leaves missing, " << stale << " removed ones returned, "
+		<< partMismatches << " split queries differ" << std::endl;
+	CHECK(missing == 0);
+	CHECK(stale == 0);
+	CHECK(partMismatches == 0);
+}
+
+//a narrow view at a fixed density sees about the same boxes at any count, so a linear
+//walk would visit 30 times the nodes at 30 times the leaves. Inserted one by one the
+//upper nodes overlap more as the tree grows, the visits grow faster than the height
+//but have to stay far below linear
+static void checkGrowth()
+{
+	const unsigned int counts[] = { 10000, 100000, 300000 };
+	unsigned int visited[3];
+
+	for (int c = 0; c < 3; c++)
+	{
+		float half = halfSide(counts[c]);
+		unsigned int seed = 0xa54ff53au;
+		BoundsTree tree;
+		for (unsigned int i = 0; i < counts[c]; i++)
+		{
+			Leaf leaf;
+			place(leaf, randomCenter(seed, half), seed);
+			tree.insert(leaf.low, leaf.high, i, CHECK_MARGIN);
+		}
+
+		std::vector<unsigned int> visible;
+		visited[c] = 0;
+		for (int v = 0; v < 8; v++)
+			visited[c] += queryVisited(tree, view(glm::vec3(0.0f, 4.0f, 0.0f), v * 0.785f, 10.0f, 300.0f), 1, visible);
+		visited[c] /= 8;
+		std::cout << "  " << counts[c] << " leaves, height " << tree.getHeight() << ": narrow view visits "
+			<< visited[c] << " nodes" << std::endl;
+	}
+	CHECK(visited[2] * 4 < visited[0] * 30);
+}
+
+//the trade-off against the SIMD kernel of CullingSet: the tree tests nodes one at a time
+//and skips whole subtrees, the kernel tests every box 4 or 8 at a time. The game's forest
+//is 20k entries
+static void compareWithKernel(unsigned int count)
+{
+	const int repeats = 20;
+	float half = halfSide(count);
+	unsigned int seed = 0x510e527fu;
+
+	BoundsTree tree;
+	CullingSet set;
+	set.reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Leaf leaf;
+		place(leaf, randomCenter(seed, half), seed);
+		tree.insert(leaf.low, leaf.high, i, CHECK_MARGIN);
+		set.add(leaf.low, leaf.high);
+	}
+
+	const char* names[2] = { "wide", "narrow" };
+	for (int v = 0; v < 2; v++)
+	{
+		Frustum frustum = view(glm::vec3(0.0f, 4.0f, 0.0f), 0.3f, v == 0 ? 90.0f : 10.0f, v == 0 ? 10000.0f : 300.0f);
+		std::vector<unsigned int> visible;
+		unsigned int visited = 0;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < repeats; run++)
+			visited = queryVisited(tree, frustum, 1, visible);
+		double treeMs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0 / repeats;
+		unsigned int treeVisible = visible.size();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < repeats; run++)
+			set.cull(frustum, visible);
+		double kernelMs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0 / repeats;
+
+		std::cout << "  " << names[v] << " view of " << count << " boxes: tree " << treeMs << " ms, " << visited
+			<< " nodes for " << treeVisible << " leaves; " << CullingSet::getKernelName() << " kernel " << kernelMs
+			<< " ms for " << visible.size() << std::endl;
+	}
+}
+
+void checkBoundsTree()
+{
+	checkQueries();
+	checkGrowth();
+	compareWithKernel(20000);
+	compareWithKernel(300000);
+}
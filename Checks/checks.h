@@ -0,0 +1,18 @@
+#pragma once
+
+//GPU-free checks of the engine's CPU side culling, no window or GL context needed.
+//Each check prints what it measured, failed expectations are reported through CHECK.
+//Benchmarks only print, their targets depend on the machine.
+//Release|x64 builds with /arch:AVX, the other configurations check the SSE kernels.
+void checkOcclusionCuller();
+void checkCullingSet();
+void benchmarkCullingSet();
+void checkBoundsTree();
+
+//counts a failed expectation of the running check and prints where it was
+#define CHECK(condition) checkExpect((condition), #condition, __FILE__, __LINE__)
+bool checkExpect(bool passed, const char* expression, const char* file, int line);
+
+//fixed xorshift, the generated scenes are the same on every compiler and run
+unsigned int checkRandom(unsigned int& seed);
+float checkRandom(unsigned int& seed, float low, float high);
@@ -0,0 +1,164 @@
+#include "checks.h"
+#include "..\GameEngine\Graphics\cullingSet.h"
+#include <../glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <iostream>
+
+struct Box
+{
+	glm::vec3 low, high;
+};
+
+//the kernel's test one entry at a time, with the same operations in the same order:
+//per plane the center distance against the smaller of the box and sphere reach
+static bool scalarVisible(const Frustum& frustum, const Box& box)
+{
+	glm::vec3 center = (box.low + box.high) * 0.5f;
+	glm::vec3 extent = (box.high - box.low) * 0.5f;
+	float radius = glm::length(extent);
+
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		float distance = (plane.x * center.x + plane.y * center.y) + (plane.z * center.z + plane.w);
+		float reach = glm::min((glm::abs(plane.x) * extent.x + glm::abs(plane.y) * extent.y) + glm::abs(plane.z) * extent.z, radius);
+		if (!(distance >= -reach))
+			return false;
+	}
+	return true;
+}
+
+//indices that differ between the kernel and the scalar test
+static unsigned int compare(const Frustum& frustum, const std::vector<Box>& boxes)
+{
+	CullingSet set;
+	for (unsigned int i = 0; i < boxes.size(); i++)
+		set.add(boxes[i].low, boxes[i].high);
+
+	std::vector<unsigned int> visible;
+	set.cull(frustum, visible);
+
+	std::vector<unsigned int> expected;
+	for (unsigned int i = 0; i < boxes.size(); i++)
+	{
+		if (scalarVisible(frustum, boxes[i]))
+			expected.push_back(i);
+	}
+
+	unsigned int differences = 0;
+	unsigned int a = 0, b = 0;
+	while (a < visible.size() || b < expected.size())
+	{
+		if (a < visible.size() && b < expected.size() && visible[a] == expected[b])
+		{
+			a++;
+			b++;
+		}
+		else if (b == expected.size() || (a < visible.size() && visible[a] < expected[b]))
+		{
+			a++;
+			differences++;
+		}
+		else
+		{
+			b++;
+			differences++;
+		}
+	}
+	return differences;
+}
+
+static std::vector<Box> randomBoxes(unsigned int count, unsigned int& seed)
+{
+	std::vector<Box> boxes;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 center(checkRandom(seed, -2000.0f, 2000.0f), checkRandom(seed, -200.0f, 200.0f), checkRandom(seed, -2000.0f, 2000.0f));
+		glm::vec3 extent(checkRandom(seed, 0.0f, 20.0f), checkRandom(seed, 0.0f, 20.0f), checkRandom(seed, 0.0f, 20.0f));
+		Box box = { center - extent, center + extent };
+		boxes.push_back(box);
+	}
+	return boxes;
+}
+
+static Frustum gameFrustum(float yaw)
+{
+	glm::mat4 projection = glm::perspective(90.0f, 16.0f / 9.0f, 0.1f, 10000.0f);
+	glm::vec3 eye(0.0f, 4.0f, 0.0f);
+	glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(glm::cos(yaw), -0.1f, glm::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+	return Frustum(projection * view);
+}
+
+void checkCullingSet()
+{
+	std::cout << "  kernel " << CullingSet::getKernelName() << std::endl;
+
+	//axis aligned planes at x, y = +-10 and z = -1, -100: boxes touching a plane from
+	//outside are kept, ones a hair further are dropped; zero sized boxes are points
+	Frustum box(glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 100.0f));
+	std::vector<Box> edges;
+	Box touchingLeft = { glm::vec3(-14.0f, -1.0f, -50.0f), glm::vec3(-10.0f, 1.0f, -48.0f) };
+	Box pastLeft = { glm::vec3(-14.0f, -1.0f, -50.0f), glm::vec3(-10.5f, 1.0f, -48.0f) };
+	Box touchingFar = { glm::vec3(-1.0f, -1.0f, -104.0f), glm::vec3(1.0f, 1.0f, -100.0f) };
+	Box behindNear = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.5f) };
+	Box point = { glm::vec3(0.0f, 0.0f, -50.0f), glm::vec3(0.0f, 0.0f, -50.0f) };
+	Box around = { glm::vec3(-500.0f), glm::vec3(500.0f) };
+	edges.push_back(touchingLeft);
+	edges.push_back(pastLeft);
+	edges.push_back(touchingFar);
+	edges.push_back(behindNear);
+	edges.push_back(point);
+	edges.push_back(around);
+	CHECK(scalarVisible(box, touchingLeft));
+	CHECK(!scalarVisible(box, pastLeft));
+	CHECK(scalarVisible(box, touchingFar));
+	CHECK(!scalarVisible(box, behindNear));
+	CHECK(scalarVisible(box, point));
+	CHECK(scalarVisible(box, around));
+	CHECK(compare(box, edges) == 0);
+
+	//every count up to two kernel widths past the padding, so the tail lanes are covered
+	unsigned int seed = 0x2545f491u;
+	unsigned int tailDifferences = 0;
+	for (unsigned int count = 0; count <= 3 * CULLING_LANES; count++)
+		tailDifferences += compare(gameFrustum(0.3f), randomBoxes(count, seed));
+	CHECK(tailDifferences == 0);
+
+	unsigned int differences = 0;
+	std::vector<Box> boxes = randomBoxes(100003, seed);
+	for (int view = 0; view < 16; view++)
+		differences += compare(gameFrustum(view * 0.4f), boxes);
+	std::cout << "  16 views of 100003 random boxes: " << differences << " entries differ from the scalar test" << std::endl;
+	CHECK(differences == 0);
+}
+
+//the game's view over 100k boxes spread like the benchmark forest, 0.1 ms per cull is the target
+void benchmarkCullingSet()
+{
+	const unsigned int count = 100000;
+	const int repeats = 200;
+
+	unsigned int seed = 0x6a09e667u;
+	std::vector<Box> boxes = randomBoxes(count, seed);
+	CullingSet set;
+	set.reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+		set.add(boxes[i].low, boxes[i].high);
+
+	Frustum frustum = gameFrustum(0.3f);
+	std::vector<unsigned int> visible;
+	set.cull(frustum, visible);
+
+	double total = 0.0, best = 1e9;
+	for (int run = 0; run < repeats; run++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		set.cull(frustum, visible);
+		double ms = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0;
+		total += ms;
+		best = glm::min(best, ms);
+	}
+
+	std::cout << "  " << CullingSet::getKernelName() << ", " << count << " boxes, " << visible.size() << " visible: "
+		<< total / repeats << " ms average, " << best << " ms best of " << repeats << " (target 0.1 ms)" << std::endl;
+}
@@ -0,0 +1,67 @@
+#include "checks.h"
+#include <iostream>
+#include <string.h>
+
+struct NamedCheck
+{
+	const char* name;
+	void (*run)();
+};
+
+static const NamedCheck allChecks[] =
+{
+	{ "occlusion", checkOcclusionCuller },
+	{ "culling", checkCullingSet },
+	{ "culling-benchmark", benchmarkCullingSet },
+	{ "bounds-tree", checkBoundsTree },
+};
+
+static unsigned int failures = 0;
+
+bool checkExpect(bool passed, const char* expression, const char* file, int line)
+{
+	if (!passed)
+	{
+		std::cout << "  FAILED " << expression << " (" << file << ":" << line << ")" << std::endl;
+		failures++;
+	}
+	return passed;
+}
+
+unsigned int checkRandom(unsigned int& seed)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+float checkRandom(unsigned int& seed, float low, float high)
+{
+	return low + (high - low) * (checkRandom(seed) % 65536) / 65535.0f;
+}
+
+//Checks.exe runs everything, Checks.exe <name>... only the named checks.
+//The exit code is the number of failed checks
+int main(int argc, char** argv)
+{
+	unsigned int count = sizeof(allChecks) / sizeof(allChecks[0]);
+	int failed = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bool selected = argc < 2;
+		for (int a = 1; a < argc; a++)
+			selected = selected || strcmp(argv[a], allChecks[i].name) == 0;
+		if (!selected)
+			continue;
+
+		std::cout << allChecks[i].name << ":" << std::endl;
+		failures = 0;
+		allChecks[i].run();
+		bool passed = failures == 0;
+		std::cout << (passed ? "passed" : "FAILED") << std::endl;
+		failed += passed ? 0 : 1;
+	}
+	return failed;
+}
@@ -0,0 +1,127 @@
+#include "checks.h"
+#include "..\GameEngine\Graphics\occlusionCuller.h"
+#include <../glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <string.h>
+
+//same buffer size as the game
+#define CHECK_WIDTH 256
+#define CHECK_HEIGHT 144
+
+static bool sameDepth(const OcclusionCuller& a, const OcclusionCuller& b)
+{
+	return a.getWidth() == b.getWidth() && a.getHeight() == b.getHeight() &&
+		memcmp(a.getDepth(), b.getDepth(), a.getWidth() * a.getHeight() * sizeof(float)) == 0;
+}
+
+//testBox and isVisible must agree, the workers use one and the main thread the other
+static bool visible(OcclusionCuller& culler, const glm::vec3& low, const glm::vec3& high)
+{
+	bool counted = culler.isVisible(low, high);
+	CHECK(counted == culler.testBox(low, high));
+	return counted;
+}
+
+//camera at the origin looking down -z: a 20x20 wall 20 units away and a floor
+//triangle 5 below the eye that starts behind the camera, so it needs near plane clipping
+static void addScene(OcclusionCuller& culler)
+{
+	std::vector<glm::vec3> wall;
+	wall.push_back(glm::vec3(-10.0f, -10.0f, 0.0f));
+	wall.push_back(glm::vec3(10.0f, -10.0f, 0.0f));
+	wall.push_back(glm::vec3(10.0f, 10.0f, 0.0f));
+	wall.push_back(glm::vec3(-10.0f, 10.0f, 0.0f));
+	int wallIndices[] = { 0, 1, 2, 0, 2, 3 };
+	culler.addOccluder(wall, std::vector<int>(wallIndices, wallIndices + 6),
+		glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f)), 16);
+
+	std::vector<glm::vec3> floor;
+	floor.push_back(glm::vec3(-50.0f, -5.0f, 5.0f));
+	floor.push_back(glm::vec3(50.0f, -5.0f, 5.0f));
+	floor.push_back(glm::vec3(0.0f, -5.0f, -200.0f));
+	int floorIndices[] = { 0, 1, 2 };
+	culler.addOccluder(floor, std::vector<int>(floorIndices, floorIndices + 3), glm::mat4(1.0f), 16);
+}
+
+static void checkScene(const glm::mat4& viewProj)
+{
+	OcclusionCuller culler(CHECK_WIDTH, CHECK_HEIGHT, 0);
+	addScene(culler);
+	CHECK(culler.getOccluderTriangles() == 3);
+	culler.render(viewProj);
+
+	//every depth is a cleared or rasterized [0, 1] value, the clipped floor leaks nothing
+	const float* depth = culler.getDepth();
+	bool inRange = true;
+	for (unsigned int i = 0; i < culler.getWidth() * culler.getHeight(); i++)
+		inRange = inRange && depth[i] >= 0.0f && depth[i] <= 1.0f;
+	CHECK(inRange);
+
+	CHECK(!visible(culler, glm::vec3(-1.0f, -1.0f, -40.0f), glm::vec3(1.0f, 1.0f, -38.0f)));  // behind the wall
+	CHECK(visible(culler, glm::vec3(-1.0f, -1.0f, -15.0f), glm::vec3(1.0f, 1.0f, -13.0f)));   // in front of it
+	CHECK(visible(culler, glm::vec3(8.0f, -1.0f, -40.0f), glm::vec3(40.0f, 1.0f, -38.0f)));   // partly covered
+	CHECK(visible(culler, glm::vec3(30.0f, 0.0f, -40.0f), glm::vec3(32.0f, 2.0f, -38.0f)));   // beside it
+	CHECK(!visible(culler, glm::vec3(-1.0f, -30.0f, -60.0f), glm::vec3(1.0f, -20.0f, -58.0f))); // under the floor
+	CHECK(visible(culler, glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 1.0f)));      // crossing the near plane
+	CHECK(visible(culler, glm::vec3(-1.0f, -1.0f, 5.0f), glm::vec3(1.0f, 1.0f, 7.0f)));       // behind the camera
+
+	CHECK(culler.getTested() == 7);
+	CHECK(culler.getOccluded() == 2);
+}
+
+//random triangles all around and through the near plane, rasterized with 0 to 3 workers
+static void checkThreadCounts(const glm::mat4& viewProj)
+{
+	const unsigned int scenes = 16;
+	unsigned int mismatches = 0, answerMismatches = 0;
+	unsigned int seed = 0x9e3779b9u;
+
+	for (unsigned int scene = 0; scene < scenes; scene++)
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<int> indices;
+		for (unsigned int i = 0; i < 300 * 3; i++)
+		{
+			positions.push_back(glm::vec3(checkRandom(seed, -100.0f, 100.0f), checkRandom(seed, -100.0f, 100.0f),
+				checkRandom(seed, -290.0f, 10.0f)));
+			indices.push_back(i);
+		}
+
+		OcclusionCuller single(CHECK_WIDTH, CHECK_HEIGHT, 0);
+		single.addOccluder(positions, indices, glm::mat4(1.0f), 1000);
+		single.render(viewProj);
+
+		for (unsigned int workers = 1; workers <= 3; workers++)
+		{
+			OcclusionCuller threaded(CHECK_WIDTH, CHECK_HEIGHT, workers);
+			threaded.addOccluder(positions, indices, glm::mat4(1.0f), 1000);
+			//twice, the second frame must not see anything of the first
+			threaded.render(viewProj);
+			threaded.render(viewProj);
+			if (!sameDepth(single, threaded))
+				mismatches++;
+
+			for (unsigned int box = 0; box < 64; box++)
+			{
+				glm::vec3 center(checkRandom(seed, -60.0f, 60.0f), checkRandom(seed, -60.0f, 60.0f), checkRandom(seed, -300.0f, -5.0f));
+				glm::vec3 extent(checkRandom(seed, 0.5f, 8.0f));
+				if (single.testBox(center - extent, center + extent) != threaded.testBox(center - extent, center + extent))
+					answerMismatches++;
+			}
+		}
+	}
+
+	std::cout << "  " << scenes << " random scenes on 1 to 4 threads: " << mismatches << " depth buffers and "
+		<< answerMismatches << " box answers differ" << std::endl;
+	CHECK(mismatches == 0);
+	CHECK(answerMismatches == 0);
+}
+
+void checkOcclusionCuller()
+{
+	glm::mat4 projection = glm::perspective(90.0f, 16.0f / 9.0f, 0.1f, 10000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	checkScene(projection * view);
+	checkThreadCounts(projection * view);
+}
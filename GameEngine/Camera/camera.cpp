@@ -1,6 +1,7 @@
 #include "camera.h"
 
 Camera::Camera(glm::vec3 cameraPosition)
+	: isJumping(false), jumpVelocity(0.0f)
 {
 	this->cameraPosition = cameraPosition;
 	this->cameraViewDirection = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -11,6 +12,7 @@ Camera::Camera(glm::vec3 cameraPosition)
 }
 
 Camera::Camera()
+	: isJumping(false), jumpVelocity(0.0f)
 {
 	this->cameraPosition = glm::vec3(0.0f, 0.0f, 100.0f);
 	this->cameraViewDirection = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -20,7 +20,8 @@ private:
 
 	bool isJumping;
 	float jumpVelocity;
-	const float gravity = 50.0f;
+	//static so cameras can be assigned, game state snapshots copy them every frame
+	static constexpr float gravity = 50.0f;
 
 public:
 	Camera();
@@ -0,0 +1,368 @@
+#include "boundsTree.h"
+#include <iostream>
+
+static float surfaceArea(const glm::vec3& low, const glm::vec3& high)
+{
+	glm::vec3 size = high - low;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool contains(const glm::vec3& outerLow, const glm::vec3& outerHigh, const glm::vec3& low, const glm::vec3& high)
+{
+	return glm::all(glm::lessThanEqual(outerLow, low)) && glm::all(glm::lessThanEqual(high, outerHigh));
+}
+
+BoundsTree::BoundsTree()
+	: root(BOUNDS_TREE_NULL), freeList(BOUNDS_TREE_NULL), leafCount(0),
+	visited(0), acceptedSubtrees(0), rejectedSubtrees(0), reinserts(0) {}
+
+//nodes are reused through a free list threaded over parent, indices stay valid
+int BoundsTree::allocateNode()
+{
+	int node;
+	if (freeList != BOUNDS_TREE_NULL)
+	{
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+	else
+	{
+		node = nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& n = nodes[node];
+	n.parent = BOUNDS_TREE_NULL;
+	n.children[0] = BOUNDS_TREE_NULL;
+	n.children[1] = BOUNDS_TREE_NULL;
+	n.height = 0;
+	n.data = 0;
+	return node;
+}
+
+void BoundsTree::freeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+int BoundsTree::insert(const glm::vec3& low, const glm::vec3& high, unsigned int data, float margin)
+{
+	int leaf = allocateNode();
+	nodes[leaf].low = low - glm::vec3(margin);
+	nodes[leaf].high = high + glm::vec3(margin);
+	nodes[leaf].data = data;
+
+	insertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void BoundsTree::remove(int proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+	leafCount--;
+}
+
+bool BoundsTree::update(int proxy, const glm::vec3& low, const glm::vec3& high, float margin)
+{
+	if (contains(nodes[proxy].low, nodes[proxy].high, low, high))
+		return false;
+
+	removeLeaf(proxy);
+	nodes[proxy].low = low - glm::vec3(margin);
+	nodes[proxy].high = high + glm::vec3(margin);
+	insertLeaf(proxy);
+	reinserts++;
+	return true;
+}
+
+//walks down towards the child whose box grows the least, stops where pairing with
+//the current node is cheaper than descending (surface area heuristic)
+void BoundsTree::insertLeaf(int leaf)
+{
+	if (root == BOUNDS_TREE_NULL)
+	{
+		root = leaf;
+		nodes[root].parent = BOUNDS_TREE_NULL;
+		return;
+	}
+
+	glm::vec3 leafLow = nodes[leaf].low, leafHigh = nodes[leaf].high;
+	int sibling = root;
+	while (!nodes[sibling].isLeaf())
+	{
+		const Node& n = nodes[sibling];
+		float area = surfaceArea(n.low, n.high);
+		float combined = surfaceArea(glm::min(n.low, leafLow), glm::max(n.high, leafHigh));
+
+		//a new parent here costs combined, pushing the leaf down costs at least the growth of this node
+		float cost = 2.0f * combined;
+		float inherited = 2.0f * (combined - area);
+
+		float childCost[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = nodes[n.children[i]];
+			float grown = surfaceArea(glm::min(child.low, leafLow), glm::max(child.high, leafHigh));
+			childCost[i] = child.isLeaf() ? grown + inherited : grown - surfaceArea(child.low, child.high) + inherited;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+		sibling = childCost[0] < childCost[1] ? n.children[0] : n.children[1];
+	}
+
+	int oldParent = nodes[sibling].parent;
+	int parent = allocateNode();
+	nodes[parent].parent = oldParent;
+	nodes[parent].low = glm::min(nodes[sibling].low, leafLow);
+	nodes[parent].high = glm::max(nodes[sibling].high, leafHigh);
+	nodes[parent].height = nodes[sibling].height + 1;
+	nodes[parent].children[0] = sibling;
+	nodes[parent].children[1] = leaf;
+	nodes[sibling].parent = parent;
+	nodes[leaf].parent = parent;
+
+	if (oldParent == BOUNDS_TREE_NULL)
+		root = parent;
+	else
+		nodes[oldParent].children[nodes[oldParent].children[0] == sibling ? 0 : 1] = parent;
+
+	refit(nodes[leaf].parent);
+}
+
+//the leaf's parent goes away, its sibling takes the parent's place
+void BoundsTree::removeLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = BOUNDS_TREE_NULL;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+	if (grandParent == BOUNDS_TREE_NULL)
+	{
+		root = sibling;
+		nodes[sibling].parent = BOUNDS_TREE_NULL;
+		freeNode(parent);
+		return;
+	}
+
+	nodes[grandParent].children[nodes[grandParent].children[0] == parent ? 0 : 1] = sibling;
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	refit(grandParent);
+}
+
+//balances and recomputes the boxes and heights from node up to the root
+void BoundsTree::refit(int node)
+{
+	while (node != BOUNDS_TREE_NULL)
+	{
+		node = balance(node);
+
+		Node& n = nodes[node];
+		const Node& a = nodes[n.children[0]];
+		const Node& b = nodes[n.children[1]];
+		n.low = glm::min(a.low, b.low);
+		n.high = glm::max(a.high, b.high);
+		n.height = 1 + glm::max(a.height, b.height);
+
+		node = n.parent;
+	}
+}
+
+//when one child is more than one level taller, its taller child is rotated up into
+//node's place. Returns the node now at that position
+int BoundsTree::balance(int a)
+{
+	if (nodes[a].isLeaf() || nodes[a].height < 2)
+		return a;
+
+	int b = nodes[a].children[0];
+	int c = nodes[a].children[1];
+	int difference = nodes[c].height - nodes[b].height;
+	if (difference >= -1 && difference <= 1)
+		return a;
+
+	//up is the taller child, down its sibling stays under a
+	int up = difference > 0 ? c : b;
+	int down = difference > 0 ? b : c;
+	int upSlot = difference > 0 ? 1 : 0;
+
+	int f = nodes[up].children[0];
+	int g = nodes[up].children[1];
+
+	//up takes a's place
+	nodes[up].children[0] = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+	if (nodes[up].parent == BOUNDS_TREE_NULL)
+		root = up;
+	else
+	{
+		Node& parent = nodes[nodes[up].parent];
+		parent.children[parent.children[0] == a ? 0 : 1] = up;
+	}
+
+	//the taller grandchild stays with up, the other one replaces up under a
+	int keep = nodes[f].height > nodes[g].height ? f : g;
+	int give = keep == f ? g : f;
+	nodes[up].children[1] = keep;
+	nodes[a].children[upSlot] = give;
+	nodes[give].parent = a;
+
+	Node& na = nodes[a];
+	na.low = glm::min(nodes[down].low, nodes[give].low);
+	na.high = glm::max(nodes[down].high, nodes[give].high);
+	na.height = 1 + glm::max(nodes[down].height, nodes[give].height);
+
+	Node& nu = nodes[up];
+	nu.low = glm::min(na.low, nodes[keep].low);
+	nu.high = glm::max(na.high, nodes[keep].high);
+	nu.height = 1 + glm::max(na.height, nodes[keep].height);
+
+	return up;
+}
+
+void BoundsTree::collect(int node, std::vector<unsigned int>& visible) const
+{
+	if (nodes[node].isLeaf())
+	{
+		visible.push_back(nodes[node].data);
+		return;
+	}
+	collect(nodes[node].children[0], visible);
+	collect(nodes[node].children[1], visible);
+}
+
+//recursion depth is the tree height, which the rotations keep logarithmic
+void BoundsTree::queryNode(const Frustum& frustum, int node, unsigned int mask, std::vector<unsigned int>& visible,
+	BoundsQueryCounts& counts) const
+{
+	counts.visited++;
+
+	const Node& n = nodes[node];
+	FrustumResult result = frustum.classify(n.low, n.high, mask);
+	if (result == FRUSTUM_OUTSIDE)
+	{
+		counts.rejected++;
+		return;
+	}
+	if (result == FRUSTUM_INSIDE || n.isLeaf())
+	{
+		if (!n.isLeaf())
+			counts.accepted++;
+		collect(node, visible);
+		return;
+	}
+
+	queryNode(frustum, n.children[0], mask, visible, counts);
+	queryNode(frustum, n.children[1], mask, visible, counts);
+}
+
+void BoundsTree::query(const Frustum& frustum, std::vector<unsigned int>& visible)
+{
+	split(frustum, 1, querySubtrees);
+
+	visible.clear();
+	BoundsQueryCounts counts;
+	for (unsigned int i = 0; i < querySubtrees.size(); i++)
+		query(frustum, querySubtrees[i], visible, counts);
+	addCounts(counts);
+}
+
+//a node is opened only when it straddles the frustum; the ones fully inside stay whole
+//so their leaves are collected by the threads, not here
+void BoundsTree::split(const Frustum& frustum, unsigned int count, std::vector<BoundsSubtree>& subtrees)
+{
+	subtrees.clear();
+	visited = 0;
+	acceptedSubtrees = 0;
+	rejectedSubtrees = 0;
+	if (root == BOUNDS_TREE_NULL)
+		return;
+
+	BoundsSubtree start = { root, FRUSTUM_ALL_PLANES };
+	subtrees.push_back(start);
+
+	bool openedAny = true;
+	while (openedAny && subtrees.size() < count)
+	{
+		openedAny = false;
+		opened.clear();
+		for (unsigned int i = 0; i < subtrees.size(); i++)
+		{
+			const BoundsSubtree& subtree = subtrees[i];
+			const Node& n = nodes[subtree.node];
+			if (n.isLeaf() || subtree.mask == 0)
+			{
+				opened.push_back(subtree);
+				continue;
+			}
+
+			unsigned int mask = subtree.mask;
+			FrustumResult result = frustum.classify(n.low, n.high, mask);
+			if (result == FRUSTUM_OUTSIDE)
+			{
+				visited++;
+				rejectedSubtrees++;
+				continue;
+			}
+			if (result == FRUSTUM_INSIDE)
+			{
+				BoundsSubtree inside = { subtree.node, 0 };
+				opened.push_back(inside);
+				continue;
+			}
+
+			visited++;
+			BoundsSubtree first = { n.children[0], mask };
+			BoundsSubtree second = { n.children[1], mask };
+			opened.push_back(first);
+			opened.push_back(second);
+			openedAny = true;
+		}
+		subtrees.swap(opened);
+	}
+}
+
+void BoundsTree::query(const Frustum& frustum, const BoundsSubtree& subtree, std::vector<unsigned int>& visible,
+	BoundsQueryCounts& counts) const
+{
+	queryNode(frustum, subtree.node, subtree.mask, visible, counts);
+}
+
+void BoundsTree::addCounts(const BoundsQueryCounts& counts)
+{
+	visited += counts.visited;
+	acceptedSubtrees += counts.accepted;
+	rejectedSubtrees += counts.rejected;
+}
+
+unsigned int BoundsTree::getLeafCount() const
+{
+	return leafCount;
+}
+
+int BoundsTree::getHeight() const
+{
+	return root == BOUNDS_TREE_NULL ? 0 : nodes[root].height;
+}
+
+void BoundsTree::printReport()
+{
+	std::cout << "Bounds tree: " << leafCount << " objects, height " << getHeight() << ", last query visited "
+		<< visited << " nodes, " << acceptedSubtrees << " subtrees accepted and " << rejectedSubtrees
+		<< " rejected whole, " << reinserts << " reinserts since last report" << std::endl;
+
+	reinserts = 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include "frustum.h"
+
+//proxy value of an object that is not in a tree
+#define BOUNDS_TREE_NULL -1
+
+//a part of one query, see BoundsTree::split()
+struct BoundsSubtree
+{
+	int node;
+	unsigned int mask; // planes the node still straddles, 0 when it is fully inside
+};
+
+//work of the queries of one thread, added back with BoundsTree::addCounts()
+struct BoundsQueryCounts
+{
+	unsigned int visited, accepted, rejected;
+
+	BoundsQueryCounts() : visited(0), accepted(0), rejected(0) {}
+};
+
+//Dynamic AABB tree over the renderables of a scene: leaves hold one object's world
+//box grown by a margin, inner nodes the union of their children. Inserts pick the
+//sibling that adds the least surface area and rotations keep the tree balanced,
+//so queries visit O(log n) nodes plus the ones they return.
+//Moving objects call update(); nothing changes while the box stays inside its
+//fat leaf, otherwise only that leaf is reinserted and its ancestors refit.
+class BoundsTree
+{
+public:
+	BoundsTree();
+
+	//returns the proxy, data comes back from query()
+	int insert(const glm::vec3& low, const glm::vec3& high, unsigned int data, float margin);
+	void remove(int proxy);
+	//true when the leaf had to move
+	bool update(int proxy, const glm::vec3& low, const glm::vec3& high, float margin);
+
+	//data of every leaf intersecting the frustum, in no particular order. Subtrees fully
+	//inside are taken without testing their nodes, ones fully outside are skipped
+	void query(const Frustum& frustum, std::vector<unsigned int>& visible);
+
+	//the same query in parts for several threads: the nodes near the root are classified
+	//level by level until there are at least count subtrees left or nothing more to open.
+	//The subtrees come out in the same order for the same tree and frustum
+	void split(const Frustum& frustum, unsigned int count, std::vector<BoundsSubtree>& subtrees);
+	//appends the data of the subtree's visible leaves. Any number of threads can query
+	//the subtrees of one split() as long as the tree does not change
+	void query(const Frustum& frustum, const BoundsSubtree& subtree, std::vector<unsigned int>& visible,
+		BoundsQueryCounts& counts) const;
+	//adds the counts of the threads to the report of the last split()
+	void addCounts(const BoundsQueryCounts& counts);
+
+	unsigned int getLeafCount() const;
+	int getHeight() const;
+
+	void printReport();
+
+private:
+	struct Node
+	{
+		glm::vec3 low, high;
+		int parent;   // next free node while on the free list
+		int children[2];
+		int height;   // leaves are 0, free nodes -1
+		unsigned int data;
+
+		bool isLeaf() const { return children[0] == BOUNDS_TREE_NULL; }
+	};
+
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+	void refit(int node);
+	void collect(int node, std::vector<unsigned int>& visible) const;
+	void queryNode(const Frustum& frustum, int node, unsigned int mask, std::vector<unsigned int>& visible,
+		BoundsQueryCounts& counts) const;
+
+	std::vector<Node> nodes;
+	std::vector<BoundsSubtree> querySubtrees; // query() runs as one split
+	std::vector<BoundsSubtree> opened;        // split scratch
+	int root;
+	int freeList;
+	unsigned int leafCount;
+
+	unsigned int visited, acceptedSubtrees, rejectedSubtrees, reinserts; // last query or split, reinserts since last report
+};
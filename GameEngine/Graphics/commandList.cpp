@@ -0,0 +1,34 @@
+#include "commandList.h"
+
+void CommandList::clear()
+{
+	packets.clear();
+}
+
+void CommandList::add(DrawPacketType type, unsigned int level, unsigned int mesh, unsigned int object)
+{
+	DrawPacket packet;
+	packet.type = (uint8_t)type;
+	packet.level = (uint8_t)level;
+	packet.mesh = (uint16_t)mesh;
+	packet.object = object;
+	packets.push_back(packet);
+}
+
+unsigned int CommandList::size() const
+{
+	return packets.size();
+}
+
+const DrawPacket& CommandList::operator[](unsigned int i) const
+{
+	return packets[i];
+}
+
+unsigned int CommandList::count(const std::vector<CommandList>& lists)
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < lists.size(); i++)
+		total += lists[i].size();
+	return total;
+}
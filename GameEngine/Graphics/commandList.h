@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+//what a packet asks for, the GL thread picks the draw path
+enum DrawPacketType
+{
+	DRAW_PACKET_MESH,    // one object of a mesh table at a shader LOD level
+	DRAW_PACKET_IMPOSTOR // one impostor instance
+};
+
+//8 bytes, no GL names or pointers: mesh and object index tables the recording
+//and the replaying side agree on
+struct DrawPacket
+{
+	uint8_t type;
+	uint8_t level;
+	uint16_t mesh;
+	uint32_t object;
+};
+
+//Packets recorded by one thread, replayed by the GL thread. Lists of a frame are
+//merged in thread order
+class CommandList
+{
+public:
+	void clear();
+	void add(DrawPacketType type, unsigned int level, unsigned int mesh, unsigned int object);
+
+	unsigned int size() const;
+	const DrawPacket& operator[](unsigned int i) const;
+
+	//packets in all lists
+	static unsigned int count(const std::vector<CommandList>& lists);
+
+private:
+	std::vector<DrawPacket> packets;
+};
@@ -0,0 +1,242 @@
+#include "cullingSet.h"
+#include "..\Model Loading\mesh.h"
+#include <immintrin.h>
+#include <chrono>
+#include <iostream>
+
+//lane helpers, one set per instruction set so the kernel is written once
+#ifdef __AVX__
+typedef __m256 Lanes;
+#define KERNEL_NAME "AVX"
+#define KERNEL_WIDTH 8
+
+static inline Lanes splat(float value) { return _mm256_set1_ps(value); }
+static inline Lanes load(const float* values) { return _mm256_loadu_ps(values); }
+static inline Lanes plus(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes times(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes minimum(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+static inline Lanes both(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+static inline Lanes notBelow(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline Lanes negate(Lanes a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+static inline int laneMask(Lanes a) { return _mm256_movemask_ps(a); }
+#else
+typedef __m128 Lanes;
+#define KERNEL_NAME "SSE"
+#define KERNEL_WIDTH 4
+
+static inline Lanes splat(float value) { return _mm_set1_ps(value); }
+static inline Lanes load(const float* values) { return _mm_loadu_ps(values); }
+static inline Lanes plus(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes times(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes minimum(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+static inline Lanes both(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+static inline Lanes notBelow(Lanes a, Lanes b) { return _mm_cmpge_ps(a, b); }
+static inline Lanes negate(Lanes a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+static inline int laneMask(Lanes a) { return _mm_movemask_ps(a); }
+#endif
+
+//the passing lanes of a group packed to the front and how many there are
+struct LanePack
+{
+	unsigned int lanes[KERNEL_WIDTH];
+	unsigned int count;
+};
+
+//one pack per lane mask, built before main() so worker threads only read it
+struct LanePacks
+{
+	LanePack masks[1 << KERNEL_WIDTH];
+
+	LanePacks()
+	{
+		for (unsigned int mask = 0; mask < (1u << KERNEL_WIDTH); mask++)
+		{
+			masks[mask].count = 0;
+			for (unsigned int lane = 0; lane < KERNEL_WIDTH; lane++)
+			{
+				masks[mask].lanes[lane] = 0;
+				if (mask & (1u << lane))
+					masks[mask].lanes[masks[mask].count++] = lane;
+			}
+		}
+	}
+};
+
+static const LanePacks lanePacks;
+
+static_assert(CULLING_LANES % KERNEL_WIDTH == 0, "CULLING_LANES must be a multiple of the kernel width");
+
+unsigned int CullingSet::tested = 0;
+unsigned int CullingSet::visibleCount = 0;
+unsigned int CullingSet::lastTested = 0;
+unsigned int CullingSet::lastVisible = 0;
+double CullingSet::seconds = 0.0;
+double CullingSet::lastSeconds = 0.0;
+
+CullingSet::CullingSet() : count(0) {}
+
+void CullingSet::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+	radius.clear();
+	count = 0;
+}
+
+void CullingSet::reserve(unsigned int count)
+{
+	unsigned int padded = (count + CULLING_LANES - 1) / CULLING_LANES * CULLING_LANES;
+	centerX.reserve(padded);
+	centerY.reserve(padded);
+	centerZ.reserve(padded);
+	extentX.reserve(padded);
+	extentY.reserve(padded);
+	extentZ.reserve(padded);
+	radius.reserve(padded);
+}
+
+//the box extent along a world axis is the sum of the model axes projected on it
+void CullingSet::transform(const Mesh& mesh, const glm::mat4& model, glm::vec3& center, glm::vec3& extent, float& sphere)
+{
+	glm::vec3 localCenter = (mesh.boundsLow + mesh.boundsHigh) * 0.5f;
+	glm::vec3 localExtent = (mesh.boundsHigh - mesh.boundsLow) * 0.5f;
+
+	center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	for (int i = 0; i < 3; i++)
+	{
+		extent[i] = glm::abs(model[0][i]) * localExtent.x + glm::abs(model[1][i]) * localExtent.y +
+			glm::abs(model[2][i]) * localExtent.z;
+	}
+
+	float scale = glm::max(glm::length(glm::vec3(model[0])),
+		glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	sphere = mesh.boundsRadius * scale;
+}
+
+unsigned int CullingSet::add(const Mesh& mesh, const glm::mat4& model)
+{
+	glm::vec3 center, extent;
+	float sphere;
+	transform(mesh, model, center, extent, sphere);
+	return push(center, extent, sphere);
+}
+
+unsigned int CullingSet::add(const glm::vec3& low, const glm::vec3& high)
+{
+	glm::vec3 extent = (high - low) * 0.5f;
+	return push((low + high) * 0.5f, extent, glm::length(extent));
+}
+
+//fills the padding up to the next CULLING_LANES entries, the kernel never reads past it
+unsigned int CullingSet::push(const glm::vec3& center, const glm::vec3& extent, float sphere)
+{
+	if (count == centerX.size())
+	{
+		unsigned int padded = centerX.size() + CULLING_LANES;
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		extentX.resize(padded, 0.0f);
+		extentY.resize(padded, 0.0f);
+		extentZ.resize(padded, 0.0f);
+		radius.resize(padded, 0.0f);
+	}
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	extentX[count] = extent.x;
+	extentY[count] = extent.y;
+	extentZ[count] = extent.z;
+	radius[count] = sphere;
+	return count++;
+}
+
+unsigned int CullingSet::getCount() const
+{
+	return count;
+}
+
+//per plane: distance of the center, and how far the bounds reach towards the plane,
+//the smaller of the box (|n| . extent) and the sphere radius
+void CullingSet::cull(const Frustum& frustum, std::vector<unsigned int>& visible) const
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Lanes nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		nx[p] = splat(plane.x);
+		ny[p] = splat(plane.y);
+		nz[p] = splat(plane.z);
+		nw[p] = splat(plane.w);
+		ax[p] = splat(glm::abs(plane.x));
+		ay[p] = splat(glm::abs(plane.y));
+		az[p] = splat(glm::abs(plane.z));
+	}
+
+	//a group's pack is stored whole, so up to a kernel width past the last visible index
+	visible.resize(count + KERNEL_WIDTH);
+	unsigned int* written = visible.data();
+	unsigned int found = 0;
+
+	for (unsigned int i = 0; i < count; i += KERNEL_WIDTH)
+	{
+		Lanes cx = load(&centerX[i]), cy = load(&centerY[i]), cz = load(&centerZ[i]);
+		Lanes ex = load(&extentX[i]), ey = load(&extentY[i]), ez = load(&extentZ[i]);
+		Lanes r = load(&radius[i]);
+
+		Lanes inside = notBelow(r, r); // all lanes set
+		for (int p = 0; p < 6; p++)
+		{
+			Lanes distance = plus(plus(times(nx[p], cx), times(ny[p], cy)), plus(times(nz[p], cz), nw[p]));
+			Lanes reach = minimum(plus(plus(times(ax[p], ex), times(ay[p], ey)), times(az[p], ez)), r);
+			inside = both(inside, notBelow(distance, negate(reach)));
+		}
+
+		//every group stores a full pack, the cursor only advances past the passing lanes
+		const LanePack& pack = lanePacks.masks[laneMask(inside)];
+		__m128i first = _mm_set1_epi32((int)i);
+		for (unsigned int lane = 0; lane < KERNEL_WIDTH; lane += 4)
+		{
+			__m128i lanes = _mm_loadu_si128((const __m128i*)&pack.lanes[lane]);
+			_mm_storeu_si128((__m128i*)&written[found + lane], _mm_add_epi32(first, lanes));
+		}
+		found += pack.count;
+	}
+
+	//padding lanes past count may have passed
+	while (found > 0 && written[found - 1] >= count)
+		found--;
+	visible.resize(found);
+
+	tested += count;
+	visibleCount += visible.size();
+	seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const char* CullingSet::getKernelName()
+{
+	return KERNEL_NAME;
+}
+
+void CullingSet::beginFrame()
+{
+	lastTested = tested;
+	lastVisible = visibleCount;
+	lastSeconds = seconds;
+	tested = 0;
+	visibleCount = 0;
+	seconds = 0.0;
+}
+
+void CullingSet::printReport()
+{
+	std::cout << "Frustum culling last frame (" << KERNEL_NAME << "): " << lastVisible << " visible, "
+		<< lastTested - lastVisible << " culled of " << lastTested << " in " << lastSeconds * 1000.0 << " ms" << std::endl;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include "frustum.h"
+
+class Mesh;
+
+//entries are padded to a multiple of the widest kernel
+#define CULLING_LANES 8
+
+//Bounds of many instances in world space, stored as one array per component so
+//cull() tests 4 (SSE) or 8 (AVX, when compiled with /arch:AVX) entries at once.
+//Each entry is a box (center, extent) and a sphere around the same center; an
+//entry is culled when either one is fully behind a plane.
+//Tested/visible counts and kernel time are summed per frame, see beginFrame().
+class CullingSet
+{
+public:
+	CullingSet();
+
+	void clear();
+	void reserve(unsigned int count);
+
+	//the mesh bounds under model, returns the entry index
+	unsigned int add(const Mesh& mesh, const glm::mat4& model);
+	//world space box, the sphere encloses it
+	unsigned int add(const glm::vec3& low, const glm::vec3& high);
+	unsigned int getCount() const;
+
+	//indices of the entries intersecting the frustum, ascending
+	void cull(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+
+	//world space box center, extent and sphere radius of a mesh under model
+	static void transform(const Mesh& mesh, const glm::mat4& model, glm::vec3& center, glm::vec3& extent, float& sphere);
+
+	//"SSE" or "AVX", whichever cull() was compiled with
+	static const char* getKernelName();
+
+	//keeps the finished frame's counts for the report
+	static void beginFrame();
+	static void printReport();
+
+private:
+	unsigned int push(const glm::vec3& center, const glm::vec3& extent, float radius);
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+	unsigned int count;
+
+	static unsigned int tested, visibleCount, lastTested, lastVisible;
+	static double seconds, lastSeconds;
+};
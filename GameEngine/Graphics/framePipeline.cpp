@@ -0,0 +1,146 @@
+#include "framePipeline.h"
+#include <iostream>
+
+FramePipeline::FramePipeline(const Step& step, FramePipelineMode mode)
+	: step(step), mode(mode), nextMode(mode), current(0), running(false),
+	generation(0), done(0), stopWorker(false), stepFrom(0), stepTo(0),
+	frames(0), steps(0), stepSeconds(0.0), waitSeconds(0.0), latencySeconds(0.0)
+{
+	inputTimes[0] = inputTimes[1] = Clock::now();
+	worker = std::thread(&FramePipeline::workerLoop, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	waitStep();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopWorker = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void FramePipeline::setMode(FramePipelineMode mode)
+{
+	nextMode = mode;
+}
+
+FramePipelineMode FramePipeline::getMode() const
+{
+	return nextMode;
+}
+
+unsigned int FramePipeline::getInputSlot() const
+{
+	//a running step fills the other slot, the next one goes back into current
+	return running ? current : 1 - current;
+}
+
+//step time is summed by whichever thread ran it, under the lock so reports can read it any time
+void FramePipeline::runStep(unsigned int from, unsigned int to)
+{
+	Clock::time_point start = Clock::now();
+	step(from, to);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stepSeconds += seconds;
+	steps++;
+}
+
+void FramePipeline::waitStep()
+{
+	if (!running)
+		return;
+
+	Clock::time_point start = Clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (done != generation)
+			finished.wait(lock);
+	}
+	waitSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+	current = 1 - current;
+	running = false;
+}
+
+unsigned int FramePipeline::beginFrame()
+{
+	unsigned int inputSlot = getInputSlot();
+	inputTimes[inputSlot] = Clock::now();
+
+	waitStep();
+	mode = nextMode;
+
+	if (mode == FRAME_PIPELINE_LATENCY)
+	{
+		runStep(current, 1 - current);
+		current = 1 - current;
+		return current;
+	}
+
+	//current is rendered while the worker builds the next state from it, both only read it.
+	//Right after a switch from latency mode this repeats the last state for one frame
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stepFrom = current;
+		stepTo = 1 - current;
+		generation++;
+	}
+	running = true;
+	wake.notify_one();
+	return current;
+}
+
+void FramePipeline::endFrame()
+{
+	latencySeconds += std::chrono::duration<double>(Clock::now() - inputTimes[current]).count();
+	frames++;
+}
+
+void FramePipeline::workerLoop()
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		unsigned int from, to;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (generation == seen && !stopWorker)
+				wake.wait(lock);
+
+			if (stopWorker)
+				break;
+			seen = generation;
+			from = stepFrom;
+			to = stepTo;
+		}
+
+		runStep(from, to);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = seen;
+		}
+		finished.notify_one();
+	}
+}
+
+void FramePipeline::printReport()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	double frameCount = frames > 0 ? frames : 1;
+	double stepCount = steps > 0 ? steps : 1;
+	std::cout << "Frame pipeline: " << (mode == FRAME_PIPELINE_THROUGHPUT ? "throughput" : "latency") << " mode, "
+		<< stepSeconds * 1000.0 / stepCount << " ms per simulation step, "
+		<< waitSeconds * 1000.0 / frameCount << " ms waiting for it per frame, "
+		<< latencySeconds * 1000.0 / frameCount << " ms input to present over " << frames << " frames" << std::endl;
+
+	frames = 0;
+	steps = 0;
+	stepSeconds = 0.0;
+	waitSeconds = 0.0;
+	latencySeconds = 0.0;
+}
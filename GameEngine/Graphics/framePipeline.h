@@ -0,0 +1,75 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+//how a frame's simulation relates to its rendering
+enum FramePipelineMode
+{
+	FRAME_PIPELINE_LATENCY,   // simulate then render, on the calling thread, one frame of input lag
+	FRAME_PIPELINE_THROUGHPUT // simulate frame N+1 on a worker while frame N renders, one frame more lag
+};
+
+//Runs the game simulation against two state slots the caller owns. A step reads
+//the finished slot and writes the other one; the render thread only ever reads the
+//slot beginFrame() returned, which nobody writes until the next beginFrame().
+//In throughput mode the step for the next frame starts as soon as the current one
+//is handed out, so simulation and rendering overlap and a frame costs the longer
+//of the two instead of their sum.
+//The pipeline only hands out slot indices, the states and inputs live with the caller;
+//slot 0 holds the starting state.
+class FramePipeline
+{
+public:
+	//advances the state in slot from into slot to, with the input written for to
+	typedef std::function<void(unsigned int from, unsigned int to)> Step;
+
+	FramePipeline(const Step& step, FramePipelineMode mode);
+	~FramePipeline();
+
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	//takes effect at the next beginFrame()
+	void setMode(FramePipelineMode mode);
+	FramePipelineMode getMode() const;
+
+	//slot of the next step, its input can be written before beginFrame() while a step
+	//is still running
+	unsigned int getInputSlot() const;
+
+	//once per frame right after the input is written, returns the slot to render.
+	//Waits in throughput mode only when the previous step is not done yet
+	unsigned int beginFrame();
+	//after the frame is presented, measures input to present latency
+	void endFrame();
+
+	//average step time, wait for the simulation and input to present latency since the last report
+	void printReport();
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	void waitStep();
+	void runStep(unsigned int from, unsigned int to);
+	void workerLoop();
+
+	Step step;
+	FramePipelineMode mode, nextMode;
+	unsigned int current; // slot of the newest finished state
+	bool running;         // a worker step is writing the other slot
+	Clock::time_point inputTimes[2]; // when each slot's input was written
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	unsigned int generation, done;
+	bool stopWorker;
+	unsigned int stepFrom, stepTo;
+
+	unsigned int frames, steps;
+	double stepSeconds, waitSeconds, latencySeconds;
+};
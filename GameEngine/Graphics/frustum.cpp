@@ -0,0 +1,64 @@
+#include "frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProj)
+{
+	//glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	planes[0] = rows[3] + rows[0]; // left
+	planes[1] = rows[3] - rows[0]; // right
+	planes[2] = rows[3] + rows[1]; // bottom
+	planes[3] = rows[3] - rows[1]; // top
+	planes[4] = rows[3] + rows[2]; // near
+	planes[5] = rows[3] - rows[2]; // far
+
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+//the box is outside when its corner furthest along a plane normal is behind the plane
+bool Frustum::intersects(const glm::vec3& low, const glm::vec3& high) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec3 corner(planes[i].x >= 0.0f ? high.x : low.x,
+			planes[i].y >= 0.0f ? high.y : low.y,
+			planes[i].z >= 0.0f ? high.z : low.z);
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+FrustumResult Frustum::classify(const glm::vec3& low, const glm::vec3& high, unsigned int& mask) const
+{
+	glm::vec3 center = (low + high) * 0.5f;
+	glm::vec3 extent = (high - low) * 0.5f;
+
+	for (int i = 0; i < 6; i++)
+	{
+		if (!(mask & (1 << i)))
+			continue;
+
+		glm::vec3 normal(planes[i]);
+		float distance = glm::dot(normal, center) + planes[i].w;
+		float reach = glm::dot(glm::abs(normal), extent);
+		if (distance < -reach)
+			return FRUSTUM_OUTSIDE;
+		if (distance >= reach)
+			mask &= ~(1 << i);
+	}
+	return mask == 0 ? FRUSTUM_INSIDE : FRUSTUM_INTERSECTS;
+}
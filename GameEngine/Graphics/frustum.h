@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm.hpp>
+
+enum FrustumResult
+{
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE
+};
+
+#define FRUSTUM_ALL_PLANES 0x3f
+
+//view frustum as six planes (xyz = normal pointing inside, w = distance)
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	Frustum() {}
+	//planes taken from the rows of projection * view
+	explicit Frustum(const glm::mat4& viewProj);
+
+	bool intersects(const glm::vec3& low, const glm::vec3& high) const;
+	bool intersects(const glm::vec3& center, float radius) const;
+
+	//tests the planes set in mask and clears the ones the box is fully inside,
+	//so the children of a box only test what their parent straddled
+	FrustumResult classify(const glm::vec3& low, const glm::vec3& high, unsigned int& mask) const;
+};
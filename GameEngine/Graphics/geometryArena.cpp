@@ -0,0 +1,332 @@
+#include "geometryArena.h"
+#include "glState.h"
+#include "..\Model Loading\mesh.h"
+#include <iostream>
+#include <stddef.h>
+
+//initial sizes, doubled whenever a mesh does not fit even after compacting
+#define ARENA_INITIAL_VERTICES (1 << 18)
+#define ARENA_INITIAL_INDEX_SLOTS (1 << 21)
+#define ARENA_INDEX_SLOT 2
+
+unsigned int GeometryArena::vao = 0;
+unsigned int GeometryArena::vbo = 0;
+unsigned int GeometryArena::ibo = 0;
+unsigned int GeometryArena::vertexCapacity = 0;
+unsigned int GeometryArena::indexCapacity = 0;
+unsigned int GeometryArena::vertexTop = 0;
+unsigned int GeometryArena::indexTop = 0;
+std::vector<GeometryArena::Block> GeometryArena::freeVertices;
+std::vector<GeometryArena::Block> GeometryArena::freeIndices;
+std::vector<GeometryArena::Allocation> GeometryArena::allocations;
+std::vector<unsigned int> GeometryArena::freeHandles;
+unsigned int GeometryArena::draws = 0;
+unsigned int GeometryArena::rebuilds = 0;
+
+void GeometryArena::init()
+{
+	glGenVertexArrays(1, &vao);
+	rebuild(ARENA_INITIAL_VERTICES, ARENA_INITIAL_INDEX_SLOTS);
+}
+
+//copies the live ranges packed into new buffers, used for both growth and defragmentation
+void GeometryArena::rebuild(unsigned int newVertexCapacity, unsigned int newIndexCapacity)
+{
+	//alignment padding can make the packed indices slightly larger than the live slots
+	unsigned int packedSlots = 0;
+	for (unsigned int i = 0; i < allocations.size(); i++)
+	{
+		if (!allocations[i].live)
+			continue;
+		unsigned int align = allocations[i].range.indexSize() / ARENA_INDEX_SLOT;
+		packedSlots = (packedSlots + align - 1) / align * align + allocations[i].indexSlots;
+	}
+	while (newIndexCapacity < packedSlots)
+		newIndexCapacity *= 2;
+
+	unsigned int newVbo, newIbo;
+	glGenBuffers(1, &newVbo);
+	glGenBuffers(1, &newIbo);
+
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, (size_t)newVertexCapacity * sizeof(ArenaVertex), NULL, GL_STATIC_DRAW);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newIbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, (size_t)newIndexCapacity * ARENA_INDEX_SLOT, NULL, GL_STATIC_DRAW);
+
+	//indices are relative to the mesh, so moving a range never rewrites them
+	unsigned int newVertexTop = 0;
+	unsigned int newIndexTop = 0;
+	for (unsigned int i = 0; i < allocations.size(); i++)
+	{
+		if (!allocations[i].live)
+			continue;
+
+		Allocation& allocation = allocations[i];
+		GeometryRange& range = allocation.range;
+
+		//32 bit indices have to start on a 4 byte boundary
+		unsigned int align = range.indexSize() / ARENA_INDEX_SLOT;
+		newIndexTop = (newIndexTop + align - 1) / align * align;
+
+		GLState::bindBuffer(GL_COPY_READ_BUFFER, vbo);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+			(size_t)range.baseVertex * sizeof(ArenaVertex), (size_t)newVertexTop * sizeof(ArenaVertex), (size_t)range.vertexCount * sizeof(ArenaVertex));
+
+		GLState::bindBuffer(GL_COPY_READ_BUFFER, ibo);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newIbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+			(size_t)allocation.indexSlot * ARENA_INDEX_SLOT, (size_t)newIndexTop * ARENA_INDEX_SLOT, (size_t)allocation.indexSlots * ARENA_INDEX_SLOT);
+
+		range.baseVertex = newVertexTop;
+		range.firstIndex = newIndexTop / align;
+		allocation.indexSlot = newIndexTop;
+		newVertexTop += range.vertexCount;
+		newIndexTop += allocation.indexSlots;
+	}
+
+	if (vbo != 0)
+	{
+		GLState::deleteBuffer(vbo);
+		GLState::deleteBuffer(ibo);
+		rebuilds++;
+	}
+
+	vbo = newVbo;
+	ibo = newIbo;
+	vertexCapacity = newVertexCapacity;
+	indexCapacity = newIndexCapacity;
+	vertexTop = newVertexTop;
+	indexTop = newIndexTop;
+	freeVertices.clear();
+	freeIndices.clear();
+
+	//point the shared VAO at the new buffers
+	GLState::bindVertexArray(vao);
+
+	GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+	ArenaVertexLayout::apply();
+}
+
+bool GeometryArena::takeBlock(std::vector<Block>& freeBlocks, unsigned int& top, unsigned int capacity, unsigned int count, unsigned int align, unsigned int& offset)
+{
+	//first fit among the holes, then the free tail
+	for (unsigned int i = 0; i < freeBlocks.size(); i++)
+	{
+		Block block = freeBlocks[i];
+		unsigned int start = (block.offset + align - 1) / align * align;
+		if (start + count > block.offset + block.count)
+			continue;
+
+		//whatever is left before and after the range stays a hole
+		offset = start;
+		freeBlocks.erase(freeBlocks.begin() + i);
+		Block after = { start + count, block.offset + block.count - (start + count) };
+		if (after.count > 0)
+			freeBlocks.insert(freeBlocks.begin() + i, after);
+		Block before = { block.offset, start - block.offset };
+		if (before.count > 0)
+			freeBlocks.insert(freeBlocks.begin() + i, before);
+		return true;
+	}
+
+	unsigned int start = (top + align - 1) / align * align;
+	if (start > capacity || capacity - start < count)
+		return false;
+
+	if (start > top)
+	{
+		Block padding = { top, start - top };
+		freeBlocks.push_back(padding);
+	}
+	offset = start;
+	top = start + count;
+	return true;
+}
+
+void GeometryArena::freeBlock(std::vector<Block>& freeBlocks, unsigned int& top, unsigned int offset, unsigned int count)
+{
+	//keep the holes sorted and merged with their neighbours
+	unsigned int i = 0;
+	while (i < freeBlocks.size() && freeBlocks[i].offset < offset)
+		i++;
+
+	Block block = { offset, count };
+	freeBlocks.insert(freeBlocks.begin() + i, block);
+
+	if (i + 1 < freeBlocks.size() && freeBlocks[i].offset + freeBlocks[i].count == freeBlocks[i + 1].offset)
+	{
+		freeBlocks[i].count += freeBlocks[i + 1].count;
+		freeBlocks.erase(freeBlocks.begin() + i + 1);
+	}
+	if (i > 0 && freeBlocks[i - 1].offset + freeBlocks[i - 1].count == freeBlocks[i].offset)
+	{
+		freeBlocks[i - 1].count += freeBlocks[i].count;
+		freeBlocks.erase(freeBlocks.begin() + i);
+	}
+
+	//a hole touching the tail gives the space back to the tail
+	if (!freeBlocks.empty() && freeBlocks.back().offset + freeBlocks.back().count == top)
+	{
+		top = freeBlocks.back().offset;
+		freeBlocks.pop_back();
+	}
+}
+
+unsigned int GeometryArena::freeCount(const std::vector<Block>& freeBlocks, unsigned int top, unsigned int capacity)
+{
+	unsigned int count = capacity - top;
+	for (unsigned int i = 0; i < freeBlocks.size(); i++)
+		count += freeBlocks[i].count;
+	return count;
+}
+
+unsigned int GeometryArena::allocate(const std::vector<Vertex>& vertices, const std::vector<int>& indices)
+{
+	if (vertices.empty() || indices.empty())
+		return 0;
+
+	if (vao == 0)
+		init();
+
+	std::vector<ArenaVertex> packed;
+	glm::vec4 dequantize;
+	packVertices(vertices, packed, dequantize);
+
+	//16 bit indices whenever every vertex can be addressed with them
+	unsigned int vertexCount = vertices.size();
+	unsigned int indexCount = indices.size();
+	unsigned int indexSize = vertexCount < 65536 ? 2 : 4;
+	unsigned int indexSlots = indexCount * indexSize / ARENA_INDEX_SLOT;
+	unsigned int align = indexSize / ARENA_INDEX_SLOT;
+
+	std::vector<unsigned short> shortIndices;
+	if (indexSize == 2)
+		shortIndices.assign(indices.begin(), indices.end());
+
+	unsigned int vertexOffset, indexSlot;
+	if (!takeBlock(freeVertices, vertexTop, vertexCapacity, vertexCount, 1, vertexOffset))
+	{
+		//compact, and grow if the holes together are still too small
+		unsigned int needed = vertexCapacity - freeCount(freeVertices, vertexTop, vertexCapacity) + vertexCount;
+		unsigned int capacity = vertexCapacity;
+		while (capacity < needed)
+			capacity *= 2;
+
+		rebuild(capacity, indexCapacity);
+		takeBlock(freeVertices, vertexTop, vertexCapacity, vertexCount, 1, vertexOffset);
+	}
+
+	if (!takeBlock(freeIndices, indexTop, indexCapacity, indexSlots, align, indexSlot))
+	{
+		//the vertex range is returned first so the rebuild packs it like any other
+		freeBlock(freeVertices, vertexTop, vertexOffset, vertexCount);
+
+		//one extra slot covers the alignment padding after compacting
+		unsigned int needed = indexCapacity - freeCount(freeIndices, indexTop, indexCapacity) + indexSlots + 1;
+		unsigned int capacity = indexCapacity;
+		while (capacity < needed)
+			capacity *= 2;
+
+		rebuild(vertexCapacity, capacity);
+		takeBlock(freeVertices, vertexTop, vertexCapacity, vertexCount, 1, vertexOffset);
+		takeBlock(freeIndices, indexTop, indexCapacity, indexSlots, align, indexSlot);
+	}
+
+	//copy buffer targets leave the VAO's element buffer alone
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)vertexOffset * sizeof(ArenaVertex), (size_t)vertexCount * sizeof(ArenaVertex), packed.data());
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+	if (indexSize == 2)
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)indexSlot * ARENA_INDEX_SLOT, (size_t)indexCount * 2, shortIndices.data());
+	else
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)indexSlot * ARENA_INDEX_SLOT, (size_t)indexCount * 4, indices.data());
+
+	Allocation allocation;
+	allocation.range.baseVertex = vertexOffset;
+	allocation.range.vertexCount = vertexCount;
+	allocation.range.firstIndex = indexSlot / align;
+	allocation.range.indexCount = indexCount;
+	allocation.range.indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	allocation.range.dequantize = dequantize;
+	allocation.indexSlot = indexSlot;
+	allocation.indexSlots = indexSlots;
+	allocation.live = true;
+
+	if (!freeHandles.empty())
+	{
+		unsigned int handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle - 1] = allocation;
+		return handle;
+	}
+
+	allocations.push_back(allocation);
+	return allocations.size();
+}
+
+void GeometryArena::release(unsigned int handle)
+{
+	if (handle == 0 || handle > allocations.size() || !allocations[handle - 1].live)
+		return;
+
+	Allocation& allocation = allocations[handle - 1];
+	freeBlock(freeVertices, vertexTop, allocation.range.baseVertex, allocation.range.vertexCount);
+	freeBlock(freeIndices, indexTop, allocation.indexSlot, allocation.indexSlots);
+	allocation.live = false;
+	freeHandles.push_back(handle);
+}
+
+const GeometryRange& GeometryArena::getRange(unsigned int handle)
+{
+	static const GeometryRange empty = { 0, 0, 0, 0, GL_UNSIGNED_INT, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) };
+	if (handle == 0 || handle > allocations.size() || !allocations[handle - 1].live)
+		return empty;
+	return allocations[handle - 1].range;
+}
+
+void GeometryArena::bind()
+{
+	if (vao == 0)
+		init();
+
+	GLState::bindVertexArray(vao);
+}
+
+void GeometryArena::draw(unsigned int handle)
+{
+	const GeometryRange& range = getRange(handle);
+	if (range.indexCount == 0)
+		return;
+
+	bind();
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, range.indexOffset(), range.baseVertex);
+	draws++;
+}
+
+void GeometryArena::countDraw()
+{
+	draws++;
+}
+
+void GeometryArena::defragment()
+{
+	if (vao != 0)
+		rebuild(vertexCapacity, indexCapacity);
+}
+
+void GeometryArena::printReport()
+{
+	unsigned int freeV = freeCount(freeVertices, vertexTop, vertexCapacity);
+	unsigned int freeI = freeCount(freeIndices, indexTop, indexCapacity);
+
+	std::cout << "Geometry arena: " << (allocations.size() - freeHandles.size()) << " meshes, "
+		<< (vertexCapacity - freeV) << "/" << vertexCapacity << " vertices, "
+		<< (indexCapacity - freeI) * ARENA_INDEX_SLOT / 1024 << "/" << indexCapacity * ARENA_INDEX_SLOT / 1024 << " KB indices, "
+		<< freeVertices.size() << " vertex holes, " << rebuilds << " rebuilds" << std::endl;
+	std::cout << "  since last report: " << draws << " draws" << std::endl;
+
+	draws = 0;
+}
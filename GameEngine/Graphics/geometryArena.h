@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "vertexFormat.h"
+
+struct Vertex;
+
+//vertex format of everything in the arena, the VAO is set up from its description
+typedef PackedVertexLayout ArenaVertexLayout;
+typedef ArenaVertexLayout::VertexType ArenaVertex;
+
+//where one mesh lives inside the shared buffers
+struct GeometryRange
+{
+	int baseVertex;           // first vertex, passed as basevertex
+	unsigned int vertexCount;
+	unsigned int firstIndex;  // first index, in indices of indexType not bytes
+	unsigned int indexCount;
+	unsigned int indexType;   // GL_UNSIGNED_SHORT below 65,536 vertices, else GL_UNSIGNED_INT
+	glm::vec4 dequantize;     // position = stored * w + xyz, set as meshDequant
+
+	unsigned int indexSize() const { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+	void* indexOffset() const { return (void*)((size_t)firstIndex * indexSize()); }
+};
+
+//All static meshes sub-allocated from one vertex buffer and one index buffer
+//sharing the ArenaVertex format and a single VAO:
+// - vertices are packed on upload, indices are 16 bit when the mesh allows it
+// - draws use glDrawElementsBaseVertex with the range offsets
+// - freed ranges are reused first fit, a full arena is compacted or grown
+// - handles stay valid when ranges move, look the range up at draw time
+class GeometryArena
+{
+public:
+	//returns a handle, 0 if nothing was uploaded
+	static unsigned int allocate(const std::vector<Vertex>& vertices, const std::vector<int>& indices);
+	static void release(unsigned int handle);
+
+	static const GeometryRange& getRange(unsigned int handle);
+
+	//binds the shared VAO, GLState drops it when it is still bound
+	static void bind();
+	static void draw(unsigned int handle);
+	//for draws issued elsewhere against the arena VAO (instanced, indirect)
+	static void countDraw();
+
+	//moves every live range to the front of new buffers, dropping the holes
+	static void defragment();
+
+	static void printReport();
+
+private:
+	struct Allocation
+	{
+		GeometryRange range;
+		unsigned int indexSlot;  // index space is counted in 2 byte slots
+		unsigned int indexSlots;
+		bool live;
+	};
+
+	struct Block
+	{
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	static void init();
+	static void rebuild(unsigned int newVertexCapacity, unsigned int newIndexCapacity);
+	static bool takeBlock(std::vector<Block>& freeBlocks, unsigned int& top, unsigned int capacity, unsigned int count, unsigned int align, unsigned int& offset);
+	static void freeBlock(std::vector<Block>& freeBlocks, unsigned int& top, unsigned int offset, unsigned int count);
+	static unsigned int freeCount(const std::vector<Block>& freeBlocks, unsigned int top, unsigned int capacity);
+
+	static unsigned int vao, vbo, ibo;
+	static unsigned int vertexCapacity, indexCapacity; // vertices, index slots
+	static unsigned int vertexTop, indexTop; // everything from top to capacity is free
+	static std::vector<Block> freeVertices;
+	static std::vector<Block> freeIndices;
+	static std::vector<Allocation> allocations;
+	static std::vector<unsigned int> freeHandles;
+	static unsigned int draws, rebuilds;
+};
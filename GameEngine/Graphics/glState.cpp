@@ -0,0 +1,304 @@
+#include "glState.h"
+#include <vector>
+#include <string.h>
+#include <iostream>
+
+//shadow value meaning "not known", never a valid GL name or enum
+#define UNKNOWN 0xffffffffu
+
+//the shadows start at the defaults of a new context
+unsigned int GLState::program = 0;
+unsigned int GLState::vertexArray = 0;
+unsigned int GLState::buffers[6] = {};
+GLState::BufferRange GLState::ranges[2][GL_STATE_BUFFER_BINDINGS] = {};
+unsigned int GLState::activeUnit = 0;
+unsigned int GLState::textures[GL_STATE_TEXTURE_UNITS] = {};
+unsigned int GLState::depth = GL_LESS;
+unsigned int GLState::depthWrite = 1;
+unsigned int GLState::blendSource = GL_ONE;
+unsigned int GLState::blendDestination = GL_ZERO;
+unsigned int GLState::enabled[3] = {};
+unsigned int GLState::issued[STATE_CALL_TYPES] = {};
+unsigned int GLState::filtered[STATE_CALL_TYPES] = {};
+unsigned int GLState::lastIssued[STATE_CALL_TYPES] = {};
+unsigned int GLState::lastFiltered[STATE_CALL_TYPES] = {};
+
+//last value per program and location, size 0 when unknown
+struct UniformValue
+{
+	unsigned int size;
+	float data[16];
+};
+
+static std::vector<std::vector<UniformValue> > uniformValues;
+
+int GLState::bufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_COPY_READ_BUFFER: return 1;
+	case GL_COPY_WRITE_BUFFER: return 2;
+	case GL_DRAW_INDIRECT_BUFFER: return 3;
+	case GL_UNIFORM_BUFFER: return 4;
+	case GL_SHADER_STORAGE_BUFFER: return 5;
+	}
+	return -1;
+}
+
+int GLState::indexedSlot(GLenum target)
+{
+	if (target == GL_UNIFORM_BUFFER)
+		return 0;
+	if (target == GL_SHADER_STORAGE_BUFFER)
+		return 1;
+	return -1;
+}
+
+//counts the call, true when it has to reach the driver
+bool GLState::filter(GLStateCall type, bool same)
+{
+	if (same)
+	{
+		filtered[type]++;
+		return false;
+	}
+	issued[type]++;
+	return true;
+}
+
+void GLState::useProgram(unsigned int program)
+{
+	if (filter(STATE_CALL_PROGRAM, GLState::program == program))
+	{
+		glUseProgram(program);
+		GLState::program = program;
+	}
+}
+
+void GLState::bindVertexArray(unsigned int vao)
+{
+	if (filter(STATE_CALL_VERTEX_ARRAY, vertexArray == vao))
+	{
+		glBindVertexArray(vao);
+		vertexArray = vao;
+	}
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer)
+{
+	int slot = bufferSlot(target);
+	if (filter(STATE_CALL_BUFFER, slot >= 0 && buffers[slot] == buffer))
+	{
+		glBindBuffer(target, buffer);
+		if (slot >= 0)
+			buffers[slot] = buffer;
+	}
+}
+
+//indexed binds also set the generic binding of the target
+void GLState::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+{
+	int slot = indexedSlot(target);
+	bool known = slot >= 0 && index < GL_STATE_BUFFER_BINDINGS;
+	BufferRange* range = known ? &ranges[slot][index] : NULL;
+
+	if (filter(STATE_CALL_BUFFER, known && range->buffer == buffer && range->size == 0))
+	{
+		glBindBufferBase(target, index, buffer);
+		if (known)
+		{
+			range->buffer = buffer;
+			range->offset = 0;
+			range->size = 0;
+		}
+		if (bufferSlot(target) >= 0)
+			buffers[bufferSlot(target)] = buffer;
+	}
+}
+
+void GLState::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+{
+	int slot = indexedSlot(target);
+	bool known = slot >= 0 && index < GL_STATE_BUFFER_BINDINGS;
+	BufferRange* range = known ? &ranges[slot][index] : NULL;
+
+	if (filter(STATE_CALL_BUFFER, known && range->buffer == buffer && range->offset == offset && range->size == size))
+	{
+		glBindBufferRange(target, index, buffer, offset, size);
+		if (known)
+		{
+			range->buffer = buffer;
+			range->offset = offset;
+			range->size = size;
+		}
+		if (bufferSlot(target) >= 0)
+			buffers[bufferSlot(target)] = buffer;
+	}
+}
+
+//deleting resets the context's bindings of the buffer to 0
+void GLState::deleteBuffer(unsigned int buffer)
+{
+	if (buffer == 0)
+		return;
+	glDeleteBuffers(1, &buffer);
+
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		if (buffers[i] == buffer)
+			buffers[i] = 0;
+	}
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		for (unsigned int j = 0; j < GL_STATE_BUFFER_BINDINGS; j++)
+		{
+			if (ranges[i][j].buffer == buffer)
+				ranges[i][j].buffer = 0;
+		}
+	}
+}
+
+void GLState::bindTexture(unsigned int unit, unsigned int texture, GLenum target)
+{
+	bool known = unit < GL_STATE_TEXTURE_UNITS;
+	if (!filter(STATE_CALL_TEXTURE, known && textures[unit] == texture))
+		return;
+
+	if (filter(STATE_CALL_ACTIVE_TEXTURE, activeUnit == unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+	if (known)
+		textures[unit] = texture;
+}
+
+void GLState::depthFunc(GLenum func)
+{
+	if (filter(STATE_CALL_RASTER, depth == func))
+	{
+		glDepthFunc(func);
+		depth = func;
+	}
+}
+
+void GLState::depthMask(bool enabled)
+{
+	if (filter(STATE_CALL_RASTER, depthWrite == (unsigned int)enabled))
+	{
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		depthWrite = enabled;
+	}
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+	if (filter(STATE_CALL_RASTER, blendSource == source && blendDestination == destination))
+	{
+		glBlendFunc(source, destination);
+		blendSource = source;
+		blendDestination = destination;
+	}
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled)
+{
+	int slot = capability == GL_DEPTH_TEST ? 0 : capability == GL_BLEND ? 1 : capability == GL_CULL_FACE ? 2 : -1;
+	if (!filter(STATE_CALL_RASTER, slot >= 0 && GLState::enabled[slot] == (unsigned int)enabled))
+		return;
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	if (slot >= 0)
+		GLState::enabled[slot] = enabled;
+}
+
+bool GLState::uniformChanged(unsigned int program, int location, const void* value, unsigned int size)
+{
+	if (location < 0 || location >= GL_STATE_UNIFORM_LOCATIONS || size > sizeof(float) * 16)
+		return filter(STATE_CALL_UNIFORM, false);
+
+	if (program >= uniformValues.size())
+		uniformValues.resize(program + 1);
+	std::vector<UniformValue>& values = uniformValues[program];
+	if ((unsigned int)location >= values.size())
+		values.resize(location + 1, UniformValue());
+
+	UniformValue& shadow = values[location];
+	if (!filter(STATE_CALL_UNIFORM, shadow.size == size && memcmp(shadow.data, value, size) == 0))
+		return false;
+
+	shadow.size = size;
+	memcpy(shadow.data, value, size);
+	return true;
+}
+
+void GLState::forgetProgram(unsigned int program)
+{
+	if (program < uniformValues.size())
+		uniformValues[program].clear();
+}
+
+void GLState::invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeUnit = UNKNOWN;
+	depth = UNKNOWN;
+	depthWrite = UNKNOWN;
+	blendSource = UNKNOWN;
+	blendDestination = UNKNOWN;
+
+	for (unsigned int i = 0; i < 6; i++)
+		buffers[i] = UNKNOWN;
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		for (unsigned int j = 0; j < GL_STATE_BUFFER_BINDINGS; j++)
+		{
+			ranges[i][j].buffer = UNKNOWN;
+			ranges[i][j].offset = 0;
+			ranges[i][j].size = 0;
+		}
+	}
+	for (unsigned int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+		textures[i] = UNKNOWN;
+	for (unsigned int i = 0; i < 3; i++)
+		enabled[i] = UNKNOWN;
+
+	uniformValues.clear();
+}
+
+void GLState::beginFrame()
+{
+	for (unsigned int i = 0; i < STATE_CALL_TYPES; i++)
+	{
+		lastIssued[i] = issued[i];
+		lastFiltered[i] = filtered[i];
+		issued[i] = 0;
+		filtered[i] = 0;
+	}
+}
+
+unsigned int GLState::getIssued(GLStateCall type)
+{
+	return lastIssued[type];
+}
+
+unsigned int GLState::getFiltered(GLStateCall type)
+{
+	return lastFiltered[type];
+}
+
+void GLState::printReport()
+{
+	static const char* names[STATE_CALL_TYPES] = { "program", "vertex array", "buffer", "texture", "active unit", "depth/blend", "uniform" };
+
+	std::cout << "GL state calls last frame (issued/filtered):";
+	for (unsigned int i = 0; i < STATE_CALL_TYPES; i++)
+		std::cout << " " << names[i] << " " << lastIssued[i] << "/" << lastFiltered[i];
+	std::cout << std::endl;
+}
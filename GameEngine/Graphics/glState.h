@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glew.h>
+
+#define GL_STATE_TEXTURE_UNITS 16
+#define GL_STATE_BUFFER_BINDINGS 8     // indexed uniform/storage binding points shadowed
+#define GL_STATE_UNIFORM_LOCATIONS 256 // per program, higher locations are never filtered
+
+//kinds of calls counted by GLState
+enum GLStateCall
+{
+	STATE_CALL_PROGRAM,
+	STATE_CALL_VERTEX_ARRAY,
+	STATE_CALL_BUFFER,
+	STATE_CALL_TEXTURE,
+	STATE_CALL_ACTIVE_TEXTURE, // the unit switch inside bindTexture, counted apart from the bind
+	STATE_CALL_RASTER, // depth and blend state
+	STATE_CALL_UNIFORM
+};
+
+#define STATE_CALL_TYPES 7
+
+//Shadows the state the renderer sets on the main context and drops calls that
+//would set what is already set. Everything on the main context binds through
+//here; after GL code that changes state behind its back call invalidate().
+//Not for the shader worker context, it has its own state.
+//Issued and filtered calls are counted per frame, see beginFrame().
+class GLState
+{
+public:
+	static void useProgram(unsigned int program);
+	static void bindVertexArray(unsigned int vao);
+
+	//GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO and is always issued
+	static void bindBuffer(GLenum target, unsigned int buffer);
+	static void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+	static void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+	//deletes and forgets it, GL may hand the name out again
+	static void deleteBuffer(unsigned int buffer);
+
+	//GL_TEXTURE_2D on the given unit, glActiveTexture only when the unit changes. Other
+	//targets share the unit's shadowed name, keep them on units of their own
+	static void bindTexture(unsigned int unit, unsigned int texture, GLenum target = GL_TEXTURE_2D);
+
+	static void depthFunc(GLenum func);
+	static void depthMask(bool enabled);
+	static void blendFunc(GLenum source, GLenum destination);
+	static void setEnabled(GLenum capability, bool enabled); // GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE
+
+	//records the value for program/location, false when it is already set (see Uniform::set)
+	static bool uniformChanged(unsigned int program, int location, const void* value, unsigned int size);
+	//a new program may reuse the name of a deleted one
+	static void forgetProgram(unsigned int program);
+
+	//everything is unknown again, the next call of each kind is issued
+	static void invalidate();
+
+	//keeps the finished frame's counts for the getters and the report
+	static void beginFrame();
+	static unsigned int getIssued(GLStateCall type);
+	static unsigned int getFiltered(GLStateCall type);
+	static void printReport();
+
+private:
+	struct BufferRange
+	{
+		unsigned int buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	static int bufferSlot(GLenum target);
+	static int indexedSlot(GLenum target);
+	static bool filter(GLStateCall type, bool same);
+
+	static unsigned int program;
+	static unsigned int vertexArray;
+	static unsigned int buffers[6];
+	static BufferRange ranges[2][GL_STATE_BUFFER_BINDINGS];
+	static unsigned int activeUnit;
+	static unsigned int textures[GL_STATE_TEXTURE_UNITS];
+	static unsigned int depth, depthWrite, blendSource, blendDestination;
+	static unsigned int enabled[3];
+
+	static unsigned int issued[STATE_CALL_TYPES], filtered[STATE_CALL_TYPES];
+	static unsigned int lastIssued[STATE_CALL_TYPES], lastFiltered[STATE_CALL_TYPES];
+};
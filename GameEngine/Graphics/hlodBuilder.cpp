@@ -0,0 +1,108 @@
+#include "hlodBuilder.h"
+#include "..\Model Loading\meshLod.h"
+
+#define HLOD_ATLAS_WIDTH (HLOD_ATLAS_MATERIALS * HLOD_ATLAS_BLOCK)
+
+HlodBuilder::HlodBuilder()
+{
+	glGenTextures(1, &atlas);
+	GLState::bindTexture(0, atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, HLOD_ATLAS_WIDTH, HLOD_ATLAS_BLOCK, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	//block centers are sampled, filtering would only blend neighbours in
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+}
+
+HlodBuilder::~HlodBuilder()
+{
+	glDeleteTextures(1, &atlas);
+}
+
+glm::vec2 HlodBuilder::materialCoords(const Mesh& mesh)
+{
+	unsigned int texture = mesh.textures.empty() ? 0 : mesh.textures[0].id;
+
+	unsigned int block = 0;
+	while (block < materials.size() && materials[block] != texture)
+		block++;
+
+	if (block == materials.size())
+	{
+		if (materials.size() == HLOD_ATLAS_MATERIALS)
+		{
+			std::cout << "HLOD atlas is full, proxies reuse its last material" << std::endl;
+			block = HLOD_ATLAS_MATERIALS - 1;
+		}
+		else
+		{
+			//the last mip level of the texture is its average color
+			unsigned char color[4] = { 200, 200, 200, 255 };
+			if (texture)
+			{
+				GLint width, height;
+				GLState::bindTexture(0, texture);
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+				int level = 0;
+				while ((width >> level) > 1 || (height >> level) > 1)
+					level++;
+				glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, color);
+			}
+
+			std::vector<unsigned char> texels(HLOD_ATLAS_BLOCK * HLOD_ATLAS_BLOCK * 4);
+			for (unsigned int i = 0; i < texels.size(); i++)
+				texels[i] = color[i % 4];
+
+			GLState::bindTexture(0, atlas);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, block * HLOD_ATLAS_BLOCK, 0, HLOD_ATLAS_BLOCK, HLOD_ATLAS_BLOCK,
+				GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+			materials.push_back(texture);
+		}
+	}
+
+	return glm::vec2((block * HLOD_ATLAS_BLOCK + HLOD_ATLAS_BLOCK * 0.5f) / HLOD_ATLAS_WIDTH, 0.5f);
+}
+
+Mesh HlodBuilder::build(const Mesh* const* meshes, const glm::mat4* models, unsigned int count, int grid, float& error)
+{
+	std::vector<Vertex> vertices;
+	std::vector<int> indices;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Mesh& mesh = *meshes[i];
+		glm::vec2 coords = materialCoords(mesh);
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(models[i])));
+
+		int base = vertices.size();
+		for (unsigned int v = 0; v < mesh.vertices.size(); v++)
+		{
+			Vertex vertex = mesh.vertices[v];
+			vertex.pos = glm::vec3(models[i] * glm::vec4(vertex.pos, 1.0f));
+			vertex.normals = glm::normalize(normalMatrix * vertex.normals);
+			vertex.textureCoords = coords;
+			vertices.push_back(vertex);
+		}
+		for (unsigned int n = 0; n < mesh.indices.size(); n++)
+			indices.push_back(base + mesh.indices[n]);
+	}
+
+	std::vector<Vertex> proxyVertices;
+	std::vector<int> proxyIndices;
+	error = MeshLod::simplify(vertices, indices, grid, proxyVertices, proxyIndices);
+
+	std::vector<Texture> textures;
+	textures.push_back(Texture{ atlas, "texture_diffuse" });
+	return Mesh(std::move(proxyVertices), std::move(proxyIndices), textures, MESH_RESIDENCY_NONE);
+}
+
+GLuint HlodBuilder::getAtlas() const
+{
+	return atlas;
+}
+
+unsigned int HlodBuilder::getMaterialCount() const
+{
+	return materials.size();
+}
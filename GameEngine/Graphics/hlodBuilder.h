@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "..\Model Loading\mesh.h"
+
+//materials the atlas has room for, each one a block of texels of one color
+#define HLOD_ATLAS_MATERIALS 64
+#define HLOD_ATLAS_BLOCK 4
+
+//Builds HLOD proxies: the instances of a cluster merged in world space and
+//simplified together into one mesh with one texture, so a far group of objects
+//is a single draw. Up close the texture detail is gone anyway, so the shared
+//atlas holds only the average color of each material's diffuse texture
+//and every proxy vertex points at its material's block.
+class HlodBuilder
+{
+public:
+	HlodBuilder();
+	~HlodBuilder();
+
+	HlodBuilder(const HlodBuilder&) = delete;
+	HlodBuilder& operator=(const HlodBuilder&) = delete;
+
+	//sources need their CPU vertices, grid is the cells along the cluster's longest side.
+	//error is how far the proxy surface can be from the sources, in world units
+	Mesh build(const Mesh* const* meshes, const glm::mat4* models, unsigned int count, int grid, float& error);
+
+	GLuint getAtlas() const;
+	unsigned int getMaterialCount() const;
+
+private:
+	//atlas coordinates of the material's block, adds it on first use
+	glm::vec2 materialCoords(const Mesh& mesh);
+
+	GLuint atlas;
+	std::vector<unsigned int> materials; // diffuse texture per block, 0 for untextured meshes
+};
@@ -0,0 +1,183 @@
+#include "impostor.h"
+#include "instanceBuffer.h"
+#include "cullingSet.h"
+#include <../glm/gtc/matrix_transform.hpp>
+
+#define IMPOSTOR_ATLAS_SIZE (IMPOSTOR_FRAMES * IMPOSTOR_FRAME_SIZE)
+
+//[-1, 1]^2 to the upper hemisphere, the inverse of encodeHemiOctahedral in impostor_vertex_shader.glsl
+static glm::vec3 decodeHemiOctahedral(const glm::vec2& e)
+{
+	glm::vec2 t = glm::vec2(e.x + e.y, e.x - e.y) * 0.5f;
+	return glm::normalize(glm::vec3(t.x, 1.0f - std::abs(t.x) - std::abs(t.y), t.y));
+}
+
+static GLuint createAtlas()
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GLState::bindTexture(0, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	//past 8x8 texels per view the mips mix neighbouring views
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+	return texture;
+}
+
+Impostor::Impostor()
+	: bakeShader("Shaders/impostor_bake_vertex_shader.glsl", "Shaders/impostor_bake_fragment_shader.glsl"),
+	drawShader("Shaders/impostor_vertex_shader.glsl", "Shaders/impostor_fragment_shader.glsl"),
+	albedo(0), normalDepth(0), center(0.0f), radius(1.0f), drawnCount(0), drawCalls(0)
+{
+	std::vector<Vertex> vertices;
+	vertices.push_back(Vertex(-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f));
+	vertices.push_back(Vertex(1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f));
+	vertices.push_back(Vertex(-1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f));
+	vertices.push_back(Vertex(1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f));
+	std::vector<int> indices = { 0, 1, 2, 2, 1, 3 };
+	quad = Mesh(vertices, indices, MESH_RESIDENCY_NONE);
+}
+
+Impostor::~Impostor()
+{
+	if (albedo)
+		glDeleteTextures(1, &albedo);
+	if (normalDepth)
+		glDeleteTextures(1, &normalDepth);
+}
+
+bool Impostor::bake(const Mesh* const* parts, const glm::mat4* models, unsigned int count)
+{
+	if (count == 0)
+		return false;
+
+	//sphere around the union of the part boxes
+	glm::vec3 low(0.0f), high(0.0f);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 partCenter, extent;
+		float sphere;
+		CullingSet::transform(*parts[i], models[i], partCenter, extent, sphere);
+		low = i == 0 ? partCenter - extent : glm::min(low, partCenter - extent);
+		high = i == 0 ? partCenter + extent : glm::max(high, partCenter + extent);
+	}
+	center = (low + high) * 0.5f;
+	radius = glm::length(high - low) * 0.5f;
+
+	if (!albedo)
+		albedo = createAtlas();
+	if (!normalDepth)
+		normalDepth = createAtlas();
+
+	GLint viewport[4];
+	GLfloat clearColor[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+	GLuint framebuffer, depth;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepth, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, buffers);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (complete)
+	{
+		//empty texels: no coverage, and the center plane so parallax doesn't pull the edges in
+		const GLfloat emptyAlbedo[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		const GLfloat emptyNormal[4] = { 0.5f, 0.5f, 1.0f, 0.5f };
+		glViewport(0, 0, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE);
+		glClearBufferfv(GL_COLOR, 0, emptyAlbedo);
+		glClearBufferfv(GL_COLOR, 1, emptyNormal);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		bakeShader.use();
+		Uniform partModel = bakeShader.getUniform("partModel");
+		Uniform frameViewProj = bakeShader.getUniform("frameViewProj");
+		glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 4.0f * radius);
+
+		for (int y = 0; y < IMPOSTOR_FRAMES; y++)
+		{
+			for (int x = 0; x < IMPOSTOR_FRAMES; x++)
+			{
+				//views sit on the grid corners so the runtime blend hits them exactly
+				glm::vec2 cell = glm::vec2((float)x, (float)y) / (float)(IMPOSTOR_FRAMES - 1);
+				glm::vec3 direction = decodeHemiOctahedral(cell * 2.0f - 1.0f);
+				glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				glm::mat4 view = glm::lookAt(center + direction * 2.0f * radius, center, up);
+
+				glViewport(x * IMPOSTOR_FRAME_SIZE, y * IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE);
+				frameViewProj.set(projection * view);
+				for (unsigned int i = 0; i < count; i++)
+				{
+					partModel.set(models[i]);
+					parts[i]->draw(bakeShader);
+				}
+			}
+		}
+	}
+	else
+		std::cout << "Impostor atlas framebuffer is incomplete, the impostor stays empty" << std::endl;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteFramebuffers(1, &framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+	if (!complete)
+		return false;
+
+	GLState::bindTexture(0, albedo);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	GLState::bindTexture(0, normalDepth);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	std::vector<Texture> textures;
+	textures.push_back(Texture{ albedo, "texture_diffuse" });
+	textures.push_back(Texture{ normalDepth, "texture_normal" });
+	quad.setTextures(textures);
+
+	std::cout << "Impostor baked: " << IMPOSTOR_FRAMES * IMPOSTOR_FRAMES << " views, radius " << radius << std::endl;
+	return true;
+}
+
+bool Impostor::isBaked() const
+{
+	return !quad.textures.empty();
+}
+
+void Impostor::draw(InstanceBuffer& instances, unsigned int first, unsigned int count)
+{
+	if (count == 0 || !isBaked())
+		return;
+
+	drawShader.use();
+	Uniform bounds = drawShader.getUniform("impostorBounds");
+	Uniform frames = drawShader.getUniform("impostorFrames");
+	bounds.set(glm::vec4(center, radius));
+	frames.set((float)IMPOSTOR_FRAMES);
+
+	instances.draw(quad, drawShader, first, count);
+	drawnCount += count;
+	drawCalls++;
+}
+
+void Impostor::printReport()
+{
+	std::cout << "Impostors: " << drawnCount << " instances in " << drawCalls << " draws since last report, atlas "
+		<< IMPOSTOR_ATLAS_SIZE << "x" << IMPOSTOR_ATLAS_SIZE << " with " << IMPOSTOR_FRAMES << "x" << IMPOSTOR_FRAMES
+		<< " views" << std::endl;
+
+	drawnCount = 0;
+	drawCalls = 0;
+}
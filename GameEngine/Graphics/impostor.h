@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include "..\Shaders\shader.h"
+#include "..\Model Loading\mesh.h"
+
+class InstanceBuffer;
+
+//views per side of the atlas and pixels per view
+#define IMPOSTOR_FRAMES 8
+#define IMPOSTOR_FRAME_SIZE 128
+
+//Octahedral impostor of a static object: at load time the object is rendered from
+//IMPOSTOR_FRAMES^2 directions over the upper hemisphere into an atlas of color and
+//normal + depth. Far instances are then one camera facing quad each; the fragment
+//shader blends the four views around the eye direction and shifts each lookup by
+//its stored depth (one parallax step), so the silhouette follows the view.
+class Impostor
+{
+public:
+	Impostor();
+	~Impostor();
+
+	Impostor(const Impostor&) = delete;
+	Impostor& operator=(const Impostor&) = delete;
+
+	//parts with a diffuse texture each, models place them relative to the object origin
+	//(translation and uniform scale). Changes the framebuffer, viewport and clear color and restores them
+	bool bake(const Mesh* const* parts, const glm::mat4* models, unsigned int count);
+	bool isBaked() const;
+
+	//one quad per instance, their models place the object origin
+	void draw(InstanceBuffer& instances, unsigned int first, unsigned int count);
+
+	void printReport();
+
+private:
+	Shader bakeShader;
+	Shader drawShader;
+	Mesh quad; // carries the atlases as its textures
+
+	GLuint albedo, normalDepth;
+	glm::vec3 center; // object space bounding sphere
+	float radius;
+
+	unsigned int drawnCount, drawCalls; // since the last report
+};
@@ -0,0 +1,253 @@
+#include "indirectRenderer.h"
+#include "glState.h"
+#include "geometryArena.h"
+#include "..\Model Loading\mesh.h"
+#include <algorithm>
+#include <new>
+#include <iostream>
+
+IndirectRenderer::IndirectRenderer()
+	: recordBuffer(0), indexBuffer(0), staticCapacity(0), staticCount(0), dynamicCapacity(0),
+	commandCount(0), multiDrawCount(0) {}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	if (recordBuffer != 0)
+	{
+		GLState::deleteBuffer(recordBuffer);
+		GLState::deleteBuffer(indexBuffer);
+	}
+}
+
+bool IndirectRenderer::isSupported()
+{
+	if (GLEW_VERSION_4_3)
+		return true;
+	return GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance && GLEW_ARB_shader_storage_buffer_object;
+}
+
+void IndirectRenderer::create(unsigned int staticCapacity, unsigned int dynamicCapacity)
+{
+	//ring regions start 256 byte aligned, enough for any storage buffer offset alignment
+	dynamicRecords.create(dynamicCapacity * sizeof(ObjectUniforms), sizeof(ObjectUniforms));
+	commands.create(1024 * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand));
+
+	resize(staticCapacity, dynamicCapacity);
+}
+
+//new index buffer, and a new static record buffer with the records copied over
+void IndirectRenderer::resize(unsigned int newStaticCapacity, unsigned int newDynamicCapacity)
+{
+	unsigned int total = newStaticCapacity + newDynamicCapacity;
+
+	if (recordBuffer == 0 || newStaticCapacity != staticCapacity)
+	{
+		unsigned int newRecordBuffer;
+		glGenBuffers(1, &newRecordBuffer);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newRecordBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, (size_t)(newStaticCapacity > 0 ? newStaticCapacity : 1) * sizeof(ObjectUniforms), NULL, GL_STATIC_DRAW);
+
+		if (recordBuffer != 0)
+		{
+			if (staticCount > 0)
+			{
+				GLState::bindBuffer(GL_COPY_READ_BUFFER, recordBuffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (size_t)staticCount * sizeof(ObjectUniforms));
+			}
+			GLState::deleteBuffer(recordBuffer);
+		}
+		recordBuffer = newRecordBuffer;
+	}
+
+	//record indices fed through a divisor 1 attribute, so no draw parameters extension is needed
+	std::vector<unsigned int> indices(total);
+	for (unsigned int i = 0; i < newStaticCapacity; i++)
+		indices[i] = i;
+	for (unsigned int i = 0; i < newDynamicCapacity; i++)
+		indices[newStaticCapacity + i] = i | INDIRECT_DYNAMIC_RECORD;
+
+	if (indexBuffer != 0)
+		GLState::deleteBuffer(indexBuffer);
+	glGenBuffers(1, &indexBuffer);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (size_t)total * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	staticCapacity = newStaticCapacity;
+	dynamicCapacity = newDynamicCapacity;
+
+	//point the arena VAO at the new index buffer
+	GeometryArena::bind();
+	GLState::bindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	glEnableVertexAttribArray(INDIRECT_ATTRIB_OBJECT);
+	glVertexAttribIPointer(INDIRECT_ATTRIB_OBJECT, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+	glVertexAttribDivisor(INDIRECT_ATTRIB_OBJECT, 1);
+}
+
+//model * translate(center) * scale(w), a uniform scale leaves the normal directions alone
+glm::mat4 IndirectRenderer::dequantized(const Mesh& mesh, const glm::mat4& model)
+{
+	const glm::vec4& dequantize = GeometryArena::getRange(mesh.geometry).dequantize;
+
+	glm::mat4 unpack(dequantize.w);
+	unpack[3] = glm::vec4(glm::vec3(dequantize), 1.0f);
+	return model * unpack;
+}
+
+unsigned int IndirectRenderer::addStatic(const Mesh& mesh, const glm::mat4* models, unsigned int count)
+{
+	//static indices sit in front of the dynamic ones, so growing moves the dynamic range
+	if (staticCount + count > staticCapacity)
+	{
+		unsigned int capacity = staticCapacity > 0 ? staticCapacity : 1;
+		while (capacity < staticCount + count)
+			capacity *= 2;
+		resize(capacity, dynamicCapacity);
+	}
+
+	std::vector<ObjectUniforms> records;
+	records.reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+		records.push_back(ObjectUniforms(dequantized(mesh, models[i])));
+
+	unsigned int first = staticCount;
+	if (!records.empty())
+	{
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, recordBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)first * sizeof(ObjectUniforms), records.size() * sizeof(ObjectUniforms), records.data());
+	}
+	staticCount += records.size();
+
+	return first;
+}
+
+//the ring starts a new region by itself, only the queued commands are dropped
+void IndirectRenderer::begin()
+{
+	for (unsigned int i = 0; i < INDIRECT_PASSES; i++)
+		passes[i].clear();
+}
+
+unsigned int IndirectRenderer::push(const Mesh& mesh, const glm::mat4& model)
+{
+	unsigned int offset;
+	void* record = dynamicRecords.allocate(sizeof(ObjectUniforms), offset);
+	new (record) ObjectUniforms(dequantized(mesh, model));
+
+	//more records than the index buffer covers, the queued draws only hold indices so it can be rebuilt
+	unsigned int index = offset / sizeof(ObjectUniforms);
+	if (index >= dynamicCapacity)
+		resize(staticCapacity, dynamicCapacity > 0 ? dynamicCapacity * 2 : 1);
+
+	return staticCapacity + index;
+}
+
+void IndirectRenderer::draw(unsigned int pass, const Mesh& mesh, unsigned int firstObject, unsigned int count)
+{
+	const GeometryRange& range = GeometryArena::getRange(mesh.geometry);
+	if (count == 0 || range.indexCount == 0)
+		return;
+
+	std::vector<QueuedDraw>& draws = passes[pass];
+	if (!draws.empty() && draws.back().mesh == &mesh &&
+		draws.back().command.baseInstance + draws.back().command.instanceCount == firstObject)
+	{
+		draws.back().command.instanceCount += count;
+		return;
+	}
+
+	QueuedDraw draw;
+	draw.mesh = &mesh;
+	draw.command.count = range.indexCount;
+	draw.command.instanceCount = count;
+	draw.command.firstIndex = range.firstIndex;
+	draw.command.baseVertex = range.baseVertex;
+	draw.command.baseInstance = firstObject;
+	draws.push_back(draw);
+}
+
+//a multi-draw needs one index type and one set of textures
+bool IndirectRenderer::sameState(const QueuedDraw& a, const QueuedDraw& b)
+{
+	if (GeometryArena::getRange(a.mesh->geometry).indexType != GeometryArena::getRange(b.mesh->geometry).indexType)
+		return false;
+
+	const std::vector<Texture>& ta = a.mesh->textures;
+	const std::vector<Texture>& tb = b.mesh->textures;
+	if (ta.size() != tb.size())
+		return false;
+	for (unsigned int i = 0; i < ta.size(); i++)
+	{
+		if (ta[i].id != tb[i].id)
+			return false;
+	}
+	return true;
+}
+
+bool IndirectRenderer::stateOrder(const QueuedDraw& a, const QueuedDraw& b)
+{
+	unsigned int typeA = GeometryArena::getRange(a.mesh->geometry).indexType;
+	unsigned int typeB = GeometryArena::getRange(b.mesh->geometry).indexType;
+	if (typeA != typeB)
+		return typeA < typeB;
+
+	const std::vector<Texture>& ta = a.mesh->textures;
+	const std::vector<Texture>& tb = b.mesh->textures;
+	for (unsigned int i = 0; i < ta.size() && i < tb.size(); i++)
+	{
+		if (ta[i].id != tb[i].id)
+			return ta[i].id < tb[i].id;
+	}
+	return ta.size() < tb.size();
+}
+
+void IndirectRenderer::submit(unsigned int pass, const Shader& shader)
+{
+	std::vector<QueuedDraw>& draws = passes[pass];
+	if (draws.empty())
+		return;
+
+	//textures and index type can't change inside a multi-draw, so draws sharing them go together
+	std::stable_sort(draws.begin(), draws.end(), stateOrder);
+
+	unsigned int offset;
+	DrawElementsIndirectCommand* written = (DrawElementsIndirectCommand*)commands.allocate(
+		draws.size() * sizeof(DrawElementsIndirectCommand), offset);
+	for (unsigned int i = 0; i < draws.size(); i++)
+		written[i] = draws[i].command;
+	size_t commandStart = commands.getRegionStart() + offset;
+
+	GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.getId());
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_STORAGE_BINDING, recordBuffer);
+	unsigned int dynamicSize = dynamicRecords.getUsed();
+	GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, DYNAMIC_STORAGE_BINDING, dynamicRecords.getId(), dynamicRecords.getRegionStart(),
+		dynamicSize > 0 ? dynamicSize : sizeof(ObjectUniforms));
+	GeometryArena::bind();
+
+	unsigned int first = 0;
+	while (first < draws.size())
+	{
+		unsigned int last = first + 1;
+		while (last < draws.size() && sameState(draws[first], draws[last]))
+			last++;
+
+		draws[first].mesh->bindMaterial(shader);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GeometryArena::getRange(draws[first].mesh->geometry).indexType,
+			(void*)(commandStart + first * sizeof(DrawElementsIndirectCommand)), last - first, 0);
+		GeometryArena::countDraw();
+		multiDrawCount++;
+
+		first = last;
+	}
+
+	commandCount += draws.size();
+	draws.clear();
+}
+
+void IndirectRenderer::printReport()
+{
+	std::cout << "Indirect: " << commandCount << " commands in " << multiDrawCount << " multi-draws, "
+		<< staticCount << " static records" << std::endl;
+
+	commandCount = 0;
+	multiDrawCount = 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "uniformBuffer.h"
+#include "ringBuffer.h"
+
+class Mesh;
+class Shader;
+
+//vertex attribute holding the object record index, see vertex_shader.glsl (INDIRECT)
+#define INDIRECT_ATTRIB_OBJECT 10
+
+//set in the object index attribute for records read from DynamicRecords
+#define INDIRECT_DYNAMIC_RECORD 0x80000000u
+
+//independent command lists, e.g. one per shader LOD level
+#define INDIRECT_PASSES 4
+
+//layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+//Collects draws of arena meshes as indirect commands and submits each pass with
+//glMultiDrawElementsIndirect, one call per texture set in the pass.
+//Static object transforms are uploaded once to a storage buffer. Dynamic records
+//and the commands are written into ring buffers, the shader sees this frame's
+//region as a second storage block. A command's baseInstance is its first record:
+//baseInstance + gl_InstanceID indexes an attribute buffer holding the static
+//record index, or the dynamic one tagged with INDIRECT_DYNAMIC_RECORD.
+//Records belong to one mesh, its position dequantization is folded into the model.
+class IndirectRenderer
+{
+public:
+	IndirectRenderer();
+	~IndirectRenderer();
+
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+	//GL 4.3 or the multi-draw indirect, base instance and storage buffer extensions
+	static bool isSupported();
+
+	void create(unsigned int staticCapacity, unsigned int dynamicCapacity);
+
+	//returns the first record, records stay until the renderer is destroyed.
+	//Call between frames, growing the static records moves the dynamic ones
+	unsigned int addStatic(const Mesh& mesh, const glm::mat4* models, unsigned int count);
+
+	//starts a frame, drops the dynamic records and all queued commands
+	void begin();
+	unsigned int push(const Mesh& mesh, const glm::mat4& model);
+
+	//queues count objects starting at record firstObject, adjacent runs of one mesh merge
+	void draw(unsigned int pass, const Mesh& mesh, unsigned int firstObject, unsigned int count);
+	void submit(unsigned int pass, const Shader& shader);
+
+	void printReport();
+
+private:
+	struct QueuedDraw
+	{
+		const Mesh* mesh;
+		DrawElementsIndirectCommand command;
+	};
+
+	static glm::mat4 dequantized(const Mesh& mesh, const glm::mat4& model);
+	static bool sameState(const QueuedDraw& a, const QueuedDraw& b);
+	static bool stateOrder(const QueuedDraw& a, const QueuedDraw& b);
+
+	void resize(unsigned int newStaticCapacity, unsigned int newDynamicCapacity);
+
+	unsigned int recordBuffer;
+	unsigned int indexBuffer;
+	unsigned int staticCapacity, staticCount;
+	unsigned int dynamicCapacity;
+
+	RingBuffer dynamicRecords;
+	RingBuffer commands;
+	std::vector<QueuedDraw> passes[INDIRECT_PASSES];
+
+	unsigned int commandCount, multiDrawCount;
+};
@@ -0,0 +1,140 @@
+#include "instanceBuffer.h"
+#include "glState.h"
+#include "geometryArena.h"
+#include "..\Model Loading\mesh.h"
+#include <stddef.h>
+#include <assert.h>
+#include <new>
+
+unsigned int InstanceBuffer::attached = 0;
+
+InstanceBuffer::InstanceBuffer() : id(0), capacity(0), count(0), dynamic(false), written(NULL), reserved(0), baseInstance(0) {}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	//deleting the buffer also detaches it from the arena VAO
+	if (attached != 0 && attached == getBuffer())
+		attached = 0;
+	if (id != 0)
+		GLState::deleteBuffer(id);
+}
+
+void InstanceBuffer::create(unsigned int capacity, bool dynamic)
+{
+	this->dynamic = dynamic;
+	this->capacity = capacity > 0 ? capacity : 1;
+
+	//regions hold whole instances, so baseInstance can address the ring directly
+	if (dynamic)
+	{
+		ring.create(this->capacity * sizeof(InstanceData), sizeof(InstanceData));
+		return;
+	}
+
+	glGenBuffers(1, &id);
+	reserve(capacity);
+}
+
+unsigned int InstanceBuffer::getBuffer()
+{
+	return dynamic ? ring.getId() : id;
+}
+
+//(re)allocates the storage, the contents are lost
+void InstanceBuffer::reserve(unsigned int count)
+{
+	capacity = count > 0 ? count : 1;
+
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, id);
+	glBufferData(GL_COPY_WRITE_BUFFER, (size_t)capacity * sizeof(InstanceData), NULL, GL_STATIC_DRAW);
+}
+
+void InstanceBuffer::upload(const std::vector<InstanceData>& instances)
+{
+	count = instances.size();
+	if (count > capacity)
+		reserve(count);
+
+	if (count == 0)
+		return;
+
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, id);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (size_t)count * sizeof(InstanceData), instances.data());
+}
+
+void InstanceBuffer::begin(unsigned int count)
+{
+	this->count = 0;
+	reserved = count > 0 ? count : 1;
+
+	//a grown ring is a new buffer, the old name may be handed out again
+	unsigned int previous = ring.getId();
+	unsigned int offset;
+	written = (InstanceData*)ring.allocate(reserved * sizeof(InstanceData), offset);
+	if (ring.getId() != previous && attached == previous)
+		attached = 0;
+
+	baseInstance = (ring.getRegionStart() + offset) / sizeof(InstanceData);
+}
+
+//the bytes behind the reservation belong to later allocations or a region the GPU may still read
+unsigned int InstanceBuffer::add(const InstanceData& instance)
+{
+	assert(count < reserved && "InstanceBuffer::add past the count given to begin()");
+	if (count >= reserved)
+		return reserved - 1;
+
+	new (&written[count]) InstanceData(instance);
+	return count++;
+}
+
+unsigned int InstanceBuffer::getCount()
+{
+	return count;
+}
+
+void InstanceBuffer::attach()
+{
+	GeometryArena::bind();
+	if (attached == getBuffer())
+		return;
+
+	GLState::bindBuffer(GL_ARRAY_BUFFER, getBuffer());
+
+	//a mat4 takes four attribute slots and a mat3 three, one column each
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_MODEL + i);
+		glVertexAttribPointer(INSTANCE_ATTRIB_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(INSTANCE_ATTRIB_MODEL + i, 1);
+	}
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_NORMAL + i);
+		glVertexAttribPointer(INSTANCE_ATTRIB_NORMAL + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(offsetof(InstanceData, normalMatrix) + i * sizeof(glm::vec3)));
+		glVertexAttribDivisor(INSTANCE_ATTRIB_NORMAL + i, 1);
+	}
+
+	attached = getBuffer();
+}
+
+void InstanceBuffer::draw(const Mesh& mesh, const Shader& shader, unsigned int first, unsigned int count)
+{
+	const GeometryRange& range = GeometryArena::getRange(mesh.geometry);
+	//a dynamic buffer only holds what was added this frame
+	if (dynamic && first + count > this->count)
+		count = first < this->count ? this->count - first : 0;
+	if (count == 0 || range.indexCount == 0)
+		return;
+
+	attach();
+	mesh.bindMaterial(shader);
+
+	//baseInstance offsets the instanced attributes, so one buffer can hold several groups
+	//and a dynamic buffer is read from this frame's ring region
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, range.indexCount, range.indexType,
+		range.indexOffset(), count, range.baseVertex, (dynamic ? baseInstance : 0) + first);
+	GeometryArena::countDraw();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "ringBuffer.h"
+
+class Mesh;
+class Shader;
+
+//first vertex attribute fed per instance, see vertex_shader.glsl (INSTANCED)
+#define INSTANCE_ATTRIB_MODEL 3  // mat4, locations 3-6
+#define INSTANCE_ATTRIB_NORMAL 7 // mat3, locations 7-9
+
+//per-instance attributes, tightly packed
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::mat3 normalMatrix;
+
+	InstanceData(const glm::mat4& model)
+		: model(model), normalMatrix(glm::transpose(glm::inverse(glm::mat3(model)))) {}
+};
+
+//Per-instance transforms for glDrawElementsInstanced* on the geometry arena VAO.
+//Static buffers are uploaded once with upload(). Dynamic ones live in a ring:
+//begin() reserves the frame's instances and add() writes them into the mapping.
+class InstanceBuffer
+{
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	void create(unsigned int capacity, bool dynamic);
+
+	void upload(const std::vector<InstanceData>& instances);
+
+	//dynamic buffers: room for count adds this frame
+	void begin(unsigned int count);
+	//returns the instance index; adds past the count given to begin() are dropped
+	unsigned int add(const InstanceData& instance);
+
+	unsigned int getCount();
+
+	//draws count instances starting at first with the mesh's textures
+	void draw(const Mesh& mesh, const Shader& shader, unsigned int first, unsigned int count);
+
+private:
+	void attach();
+	void reserve(unsigned int count);
+	unsigned int getBuffer();
+
+	unsigned int id;
+	unsigned int capacity;
+	unsigned int count;
+	bool dynamic;
+
+	RingBuffer ring;
+	InstanceData* written; // this frame's instances in the mapping
+	unsigned int reserved; // room behind written
+	unsigned int baseInstance; // index of written[0] in the ring
+
+	static unsigned int attached; // buffer the instance attributes point at
+};
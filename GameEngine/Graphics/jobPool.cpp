@@ -0,0 +1,112 @@
+#include "jobPool.h"
+#include <chrono>
+#include <iostream>
+
+JobPool::JobPool(unsigned int workers)
+	: generation(0), pending(0), stopWorkers(false), job(NULL), count(0), limit(0), runs(0), seconds(0.0)
+{
+	for (unsigned int i = 0; i < workers; i++)
+		this->workers.push_back(std::thread(&JobPool::workerLoop, this, i + 1));
+}
+
+JobPool::~JobPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopWorkers = true;
+	}
+	wake.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+unsigned int JobPool::getThreadCount() const
+{
+	return workers.size() + 1;
+}
+
+void JobPool::setThreadLimit(unsigned int threads)
+{
+	limit = threads < getThreadCount() ? threads : 0;
+}
+
+unsigned int JobPool::getActiveThreads() const
+{
+	return limit > 0 ? limit : getThreadCount();
+}
+
+void JobPool::runSlice(unsigned int thread)
+{
+	unsigned int threads = getActiveThreads();
+	if (thread >= threads)
+		return;
+
+	unsigned int begin = (unsigned int)((unsigned long long)count * thread / threads);
+	unsigned int end = (unsigned int)((unsigned long long)count * (thread + 1) / threads);
+	if (begin < end)
+		(*job)(thread, begin, end);
+}
+
+void JobPool::run(unsigned int count, const Job& job)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	this->job = &job;
+	this->count = count;
+	if (!workers.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = workers.size();
+			generation++;
+		}
+		wake.notify_all();
+	}
+
+	runSlice(0);
+
+	if (!workers.empty())
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (pending > 0)
+			finished.wait(lock);
+	}
+	this->job = NULL;
+
+	runs++;
+	seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void JobPool::workerLoop(unsigned int thread)
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (generation == seen && !stopWorkers)
+				wake.wait(lock);
+
+			if (stopWorkers)
+				break;
+			seen = generation;
+		}
+
+		runSlice(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending--;
+		}
+		finished.notify_one();
+	}
+}
+
+void JobPool::printReport()
+{
+	std::cout << "Job pool: " << getActiveThreads() << " of " << getThreadCount() << " threads, " << runs << " runs in " << seconds * 1000.0
+		<< " ms since last report" << std::endl;
+
+	runs = 0;
+	seconds = 0.0;
+}
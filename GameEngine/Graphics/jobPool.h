@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//Persistent worker threads running one parallel loop at a time for the calling
+//thread, which takes part as thread 0. run() cuts [0, count) into one contiguous
+//slice per thread and returns once all of them are done. A slice only depends on
+//count and the thread count, so per-thread output merged in thread order is the
+//same every time. Jobs must not touch GL, the context stays on the calling thread.
+class JobPool
+{
+public:
+	//thread gets the slice [begin, end)
+	typedef std::function<void(unsigned int thread, unsigned int begin, unsigned int end)> Job;
+
+	JobPool(unsigned int workers);
+	~JobPool();
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	//workers + the calling thread
+	unsigned int getThreadCount() const;
+
+	//cuts the slices of later runs for the first threads only, the others get none.
+	//For measuring how a job scales, 0 uses every thread again
+	void setThreadLimit(unsigned int threads);
+	unsigned int getActiveThreads() const;
+
+	void run(unsigned int count, const Job& job);
+
+	//runs and their wall time since the last report
+	void printReport();
+
+private:
+	void workerLoop(unsigned int thread);
+	void runSlice(unsigned int thread);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	unsigned int generation, pending;
+	bool stopWorkers;
+
+	const Job* job; // the running one
+	unsigned int count;
+	unsigned int limit;
+
+	unsigned int runs;
+	double seconds;
+};
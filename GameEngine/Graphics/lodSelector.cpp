@@ -0,0 +1,92 @@
+#include "lodSelector.h"
+#include <cmath>
+#include <iostream>
+
+//bias change per frame while over or under the target
+#define LOD_BIAS_RISE 0.02f
+#define LOD_BIAS_FALL 0.01f
+
+LodSelector::LodSelector()
+	: errorPixels(2.0f), hysteresis(0.25f), fadeSeconds(0.5f), targetFrameSeconds(1.0f / 60.0f), maxBias(3.0f),
+	pixelScale(1.0f), cameraPos(0.0f), frameSeconds(0.0f), averageFrame(1.0f / 60.0f), bias(0.0f),
+	objects(0), fading(0), transitions(0), drawnTriangles(0.0), fullTriangles(0.0) {}
+
+void LodSelector::beginFrame(const glm::mat4& projection, int viewportHeight, const glm::vec3& cameraPos, float frameSeconds)
+{
+	//projection[1][1] = 1 / tan(fov / 2), so size * pixelScale / distance is the size in pixels
+	this->pixelScale = projection[1][1] * 0.5f * (float)viewportHeight;
+	this->cameraPos = cameraPos;
+	//a stall (loading, a breakpoint) shouldn't throw the average off for seconds
+	this->frameSeconds = glm::min(frameSeconds, 0.25f);
+
+	averageFrame = averageFrame * 0.9f + this->frameSeconds * 0.1f;
+	if (averageFrame > targetFrameSeconds * 1.1f)
+		bias = glm::min(bias + LOD_BIAS_RISE, maxBias);
+	else if (averageFrame < targetFrameSeconds * 0.9f)
+		bias = glm::max(bias - LOD_BIAS_FALL, 0.0f);
+
+	objects = 0;
+	fading = 0;
+	drawnTriangles = 0.0;
+	fullTriangles = 0.0;
+}
+
+void LodSelector::select(LodState& state, const MeshLod& lod, const glm::vec3& center, float radius, float scale)
+{
+	float distance = glm::max(glm::length(center - cameraPos) - radius, 0.001f);
+	float toPixels = scale * pixelScale / distance;
+	float threshold = errorPixels * std::pow(2.0f, bias);
+	int count = lod.getLevelCount();
+
+	int level = glm::clamp(state.level, 0, count - 1);
+	while (level + 1 < count && lod.getError(level + 1) * toPixels < threshold * (1.0f - hysteresis))
+		level++;
+	while (level > 0 && lod.getError(level) * toPixels > threshold * (1.0f + hysteresis))
+		level--;
+
+	if (state.previous >= 0)
+	{
+		state.fade += frameSeconds / fadeSeconds;
+		if (state.fade >= 1.0f)
+		{
+			state.previous = -1;
+			state.fade = 1.0f;
+		}
+	}
+
+	if (state.level < 0)
+		state.level = level;
+	else if (level != state.level)
+	{
+		//a change in the middle of a fade starts over from the level it was heading to
+		state.previous = state.level;
+		state.level = level;
+		state.fade = 0.0f;
+		transitions++;
+	}
+
+	objects++;
+	fullTriangles += lod.getTriangles(0);
+	drawnTriangles += lod.getTriangles(state.level);
+	if (state.previous >= 0)
+	{
+		drawnTriangles += lod.getTriangles(state.previous);
+		fading++;
+	}
+}
+
+float LodSelector::getBias() const
+{
+	return bias;
+}
+
+void LodSelector::printReport()
+{
+	double saved = fullTriangles > 0.0 ? 100.0 * (1.0 - drawnTriangles / fullTriangles) : 0.0;
+	std::cout << "Mesh LOD: " << objects << " objects (" << fading << " crossfading), " << (unsigned int)drawnTriangles
+		<< " of " << (unsigned int)fullTriangles << " triangles drawn, " << saved << "% saved, " << transitions
+		<< " transitions since last report, bias " << bias << " (" << errorPixels * std::pow(2.0f, bias)
+		<< " px at " << averageFrame * 1000.0f << " ms average)" << std::endl;
+
+	transitions = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm.hpp>
+#include "..\Model Loading\meshLod.h"
+
+//per object, kept by the caller from frame to frame
+struct LodState
+{
+	int level;    // -1 until the first select()
+	int previous; // level fading out, -1 when no crossfade runs
+	float fade;   // crossfade progress, 0 shows only previous, 1 only level
+
+	LodState() : level(-1), previous(-1), fade(1.0f) {}
+};
+
+//Picks the coarsest MeshLod level whose error stays under errorPixels on screen.
+//A level only changes once its error is hysteresis past the threshold, so objects
+//near a boundary don't flicker, and the change is a screen-door crossfade over
+//fadeSeconds: both levels are drawn with complementary dither patterns.
+//The threshold is errorPixels * 2^bias; the bias rises while the average frame is
+//slower than targetFrameSeconds and falls back once there is headroom.
+class LodSelector
+{
+public:
+	float errorPixels;        // the errors are upper bounds, the real deviation is mostly far smaller
+	float hysteresis;         // fraction of the threshold
+	float fadeSeconds;
+	float targetFrameSeconds;
+	float maxBias;
+
+	LodSelector();
+
+	void beginFrame(const glm::mat4& projection, int viewportHeight, const glm::vec3& cameraPos, float frameSeconds);
+
+	//scale turns the model space errors into world units, center and radius bound the object
+	void select(LodState& state, const MeshLod& lod, const glm::vec3& center, float radius, float scale);
+
+	float getBias() const;
+
+	//triangles drawn this frame against drawing every object at level 0
+	void printReport();
+
+private:
+	float pixelScale;
+	glm::vec3 cameraPos;
+	float frameSeconds, averageFrame;
+	float bias;
+
+	unsigned int objects, fading, transitions; // transitions since the last report
+	double drawnTriangles, fullTriangles;
+};
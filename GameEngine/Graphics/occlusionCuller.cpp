@@ -0,0 +1,399 @@
+#include "occlusionCuller.h"
+#include "..\Model Loading\mesh.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, unsigned int workers)
+	: generation(0), pending(0), stopWorkers(false), viewProj(1.0f),
+	tested(0), occluded(0), lastTested(0), lastOccluded(0), rasterSeconds(0.0)
+{
+	tilesX = (width + OCCLUSION_TILE - 1) / OCCLUSION_TILE;
+	tilesY = (height + OCCLUSION_TILE - 1) / OCCLUSION_TILE;
+	this->width = tilesX * OCCLUSION_TILE;
+	this->height = tilesY * OCCLUSION_TILE;
+
+	unsigned int bands = workers + 1;
+	bandRows = (tilesY + bands - 1) / bands * OCCLUSION_TILE;
+
+	depth.assign(this->width * this->height, 1.0f);
+	tileMax.assign(tilesX * tilesY, 1.0f);
+
+	//band 0 belongs to the thread calling render()
+	for (unsigned int i = 1; i < bands; i++)
+		this->workers.push_back(std::thread(&OcclusionCuller::workerLoop, this, i));
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopWorkers = true;
+	}
+	wake.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void OcclusionCuller::addOccluder(const Mesh& mesh, const glm::mat4& model, unsigned int budget)
+{
+	std::vector<glm::vec3> positions = mesh.positions;
+	if (positions.empty())
+	{
+		for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+			positions.push_back(mesh.vertices[i].pos);
+	}
+	if (positions.empty() || mesh.indices.empty())
+	{
+		std::cout << "Occluder has no CPU vertices, load it with MESH_RESIDENCY_POSITIONS or FULL" << std::endl;
+		return;
+	}
+	addOccluder(positions, mesh.indices, model, budget);
+}
+
+void OcclusionCuller::addOccluder(const std::vector<glm::vec3>& positions, const std::vector<int>& indices,
+	const glm::mat4& model, unsigned int budget)
+{
+	struct Candidate
+	{
+		float area;
+		glm::vec3 corners[3];
+	};
+
+	std::vector<Candidate> candidates;
+	for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
+	{
+		Candidate candidate;
+		for (int c = 0; c < 3; c++)
+			candidate.corners[c] = glm::vec3(model * glm::vec4(positions[indices[i + c]], 1.0f));
+		candidate.area = glm::length(glm::cross(candidate.corners[1] - candidate.corners[0],
+			candidate.corners[2] - candidate.corners[0]));
+		if (candidate.area > 0.0f)
+			candidates.push_back(candidate);
+	}
+
+	//stable, so equal areas keep the mesh order and the set is the same on every run
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[](const Candidate& a, const Candidate& b) { return a.area > b.area; });
+	if (candidates.size() > budget)
+		candidates.resize(budget);
+
+	for (unsigned int i = 0; i < candidates.size(); i++)
+	{
+		for (int c = 0; c < 3; c++)
+			occluders.push_back(candidates[i].corners[c]);
+	}
+}
+
+unsigned int OcclusionCuller::getOccluderTriangles() const
+{
+	return occluders.size() / 3;
+}
+
+//clip space corners to a screen triangle, skipped when it covers no pixel center
+void OcclusionCuller::setup(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+{
+	glm::vec3 v[3];
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec3 ndc = glm::vec3(*clip[i]) / clip[i]->w;
+		v[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+	}
+
+	float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+	if (area == 0.0f)
+		return;
+
+	RasterTriangle triangle;
+	triangle.minX = glm::max(0, (int)glm::floor(glm::min(v[0].x, glm::min(v[1].x, v[2].x))));
+	triangle.maxX = glm::min((int)width - 1, (int)glm::floor(glm::max(v[0].x, glm::max(v[1].x, v[2].x))));
+	triangle.minY = glm::max(0, (int)glm::floor(glm::min(v[0].y, glm::min(v[1].y, v[2].y))));
+	triangle.maxY = glm::min((int)height - 1, (int)glm::floor(glm::max(v[0].y, glm::max(v[1].y, v[2].y))));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	//both windings are occluders, the sign makes the inside positive
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec3& p = v[i];
+		const glm::vec3& q = v[(i + 1) % 3];
+		triangle.edgeA[i] = sign * (p.y - q.y);
+		triangle.edgeB[i] = sign * (q.x - p.x);
+		triangle.edgeC[i] = sign * (p.x * q.y - p.y * q.x);
+	}
+
+	//z = depthA * x + depthB * y + depthC through the three corners
+	glm::vec3 e1 = v[1] - v[0], e2 = v[2] - v[0];
+	triangle.depthA = (e1.z * e2.y - e2.z * e1.y) / area;
+	triangle.depthB = (e2.z * e1.x - e1.z * e2.x) / area;
+	triangle.depthC = v[0].z - triangle.depthA * v[0].x - triangle.depthB * v[0].y;
+
+	triangles.push_back(triangle);
+}
+
+//the near plane (z = -w) is the only one clipped, the rest is scissored by the bounds
+void OcclusionCuller::render(const glm::mat4& viewProj)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	this->viewProj = viewProj;
+	lastTested = tested;
+	lastOccluded = occluded;
+	tested = 0;
+	occluded = 0;
+
+	triangles.clear();
+	for (unsigned int i = 0; i + 2 < occluders.size(); i += 3)
+	{
+		glm::vec4 clip[3];
+		float side[3];
+		int inside = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			clip[c] = viewProj * glm::vec4(occluders[i + c], 1.0f);
+			side[c] = clip[c].z + clip[c].w;
+			inside += side[c] >= 0.0f;
+		}
+
+		if (inside == 0)
+			continue;
+		if (inside == 3)
+		{
+			setup(clip[0], clip[1], clip[2]);
+			continue;
+		}
+
+		//one or two corners in front, the clipped polygon has 3 or 4 corners
+		glm::vec4 polygon[4];
+		int count = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int n = (c + 1) % 3;
+			if (side[c] >= 0.0f)
+				polygon[count++] = clip[c];
+			if ((side[c] >= 0.0f) != (side[n] >= 0.0f))
+				polygon[count++] = clip[c] + (clip[n] - clip[c]) * (side[c] / (side[c] - side[n]));
+		}
+		setup(polygon[0], polygon[1], polygon[2]);
+		if (count == 4)
+			setup(polygon[0], polygon[2], polygon[3]);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		generation++;
+		pending = workers.size();
+	}
+	wake.notify_all();
+
+	rasterizeBand(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (pending > 0)
+		finished.wait(lock);
+
+	rasterSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionCuller::workerLoop(unsigned int band)
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (generation == seen && !stopWorkers)
+				wake.wait(lock);
+
+			if (stopWorkers)
+				break;
+			seen = generation;
+		}
+
+		rasterizeBand(band);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending--;
+		}
+		finished.notify_one();
+	}
+}
+
+//clears the band's rows, draws every triangle touching them 4 pixels at a time,
+//then updates the band's tiles
+void OcclusionCuller::rasterizeBand(unsigned int band)
+{
+	int firstRow = band * bandRows;
+	int lastRow = glm::min((int)height, firstRow + (int)bandRows) - 1;
+	if (firstRow > lastRow)
+		return;
+
+	std::fill(depth.begin() + firstRow * width, depth.begin() + (lastRow + 1) * width, 1.0f);
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	for (unsigned int t = 0; t < triangles.size(); t++)
+	{
+		const RasterTriangle& tri = triangles[t];
+		if (tri.maxY < firstRow || tri.minY > lastRow)
+			continue;
+
+		int minY = glm::max(tri.minY, firstRow);
+		int maxY = glm::min(tri.maxY, lastRow);
+		int minX = tri.minX & ~3;
+
+		__m128 a0 = _mm_set1_ps(tri.edgeA[0]), a1 = _mm_set1_ps(tri.edgeA[1]), a2 = _mm_set1_ps(tri.edgeA[2]);
+		__m128 depthA = _mm_set1_ps(tri.depthA);
+		__m128 zero = _mm_setzero_ps();
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float centerY = y + 0.5f;
+			__m128 row0 = _mm_set1_ps(tri.edgeB[0] * centerY + tri.edgeC[0]);
+			__m128 row1 = _mm_set1_ps(tri.edgeB[1] * centerY + tri.edgeC[1]);
+			__m128 row2 = _mm_set1_ps(tri.edgeB[2] * centerY + tri.edgeC[2]);
+			__m128 rowDepth = _mm_set1_ps(tri.depthB * centerY + tri.depthC);
+			float* pixels = &depth[y * width];
+
+			for (int x = minX; x <= tri.maxX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, centerX), row0);
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, centerX), row1);
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, centerX), row2);
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth);
+				__m128 old = _mm_loadu_ps(pixels + x);
+				__m128 nearer = _mm_min_ps(old, z);
+				_mm_storeu_ps(pixels + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+		}
+	}
+
+	for (int ty = firstRow / OCCLUSION_TILE; ty <= lastRow / OCCLUSION_TILE; ty++)
+	{
+		for (unsigned int tx = 0; tx < tilesX; tx++)
+		{
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = 0; y < OCCLUSION_TILE; y++)
+			{
+				const float* pixels = &depth[(ty * OCCLUSION_TILE + y) * width + tx * OCCLUSION_TILE];
+				farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(pixels), _mm_loadu_ps(pixels + 4)));
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, farthest);
+			tileMax[ty * tilesX + tx] = glm::max(glm::max(lanes[0], lanes[1]), glm::max(lanes[2], lanes[3]));
+		}
+	}
+}
+
+//the box's nearest depth against the occluders over its screen rectangle
+bool OcclusionCuller::isVisible(const glm::vec3& low, const glm::vec3& high)
+{
+	bool visible = testBox(low, high);
+	addCounts(1, visible ? 0 : 1);
+	return visible;
+}
+
+void OcclusionCuller::addCounts(unsigned int tested, unsigned int occluded)
+{
+	this->tested += tested;
+	this->occluded += occluded;
+}
+
+bool OcclusionCuller::testBox(const glm::vec3& low, const glm::vec3& high) const
+{
+	float minX = (float)width, maxX = 0.0f, minY = (float)height, maxY = 0.0f, nearest = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner(i & 1 ? high.x : low.x, i & 2 ? high.y : low.y, i & 4 ? high.z : low.z);
+		glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+
+		//crosses the near plane, assume it is visible
+		if (clip.z < -clip.w || clip.w <= 0.0f)
+			return true;
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float x = (ndc.x * 0.5f + 0.5f) * width;
+		float y = (ndc.y * 0.5f + 0.5f) * height;
+		minX = glm::min(minX, x);
+		maxX = glm::max(maxX, x);
+		minY = glm::min(minY, y);
+		maxY = glm::max(maxY, y);
+		nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	int x0 = glm::max(0, (int)glm::floor(minX));
+	int x1 = glm::min((int)width - 1, (int)glm::floor(maxX));
+	int y0 = glm::max(0, (int)glm::floor(minY));
+	int y1 = glm::min((int)height - 1, (int)glm::floor(maxY));
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	for (int ty = y0 / OCCLUSION_TILE; ty <= y1 / OCCLUSION_TILE; ty++)
+	{
+		for (int tx = x0 / OCCLUSION_TILE; tx <= x1 / OCCLUSION_TILE; tx++)
+		{
+			if (nearest >= tileMax[ty * tilesX + tx])
+				continue;
+
+			//some pixel of the tile is farther, check the ones under the box
+			int py0 = glm::max(y0, ty * OCCLUSION_TILE), py1 = glm::min(y1, ty * OCCLUSION_TILE + OCCLUSION_TILE - 1);
+			int px0 = glm::max(x0, tx * OCCLUSION_TILE), px1 = glm::min(x1, tx * OCCLUSION_TILE + OCCLUSION_TILE - 1);
+			for (int y = py0; y <= py1; y++)
+			{
+				for (int x = px0; x <= px1; x++)
+				{
+					if (nearest < depth[y * width + x])
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+unsigned int OcclusionCuller::getWidth() const
+{
+	return width;
+}
+
+unsigned int OcclusionCuller::getHeight() const
+{
+	return height;
+}
+
+const float* OcclusionCuller::getDepth() const
+{
+	return depth.data();
+}
+
+unsigned int OcclusionCuller::getTested() const
+{
+	return tested;
+}
+
+unsigned int OcclusionCuller::getOccluded() const
+{
+	return occluded;
+}
+
+double OcclusionCuller::getRasterSeconds() const
+{
+	return rasterSeconds;
+}
+
+void OcclusionCuller::printReport()
+{
+	unsigned int rate = lastTested > 0 ? lastOccluded * 100 / lastTested : 0;
+	std::cout << "Occlusion: " << getOccluderTriangles() << " occluder triangles on " << workers.size() + 1
+		<< " threads, raster " << rasterSeconds * 1000.0 << " ms, last frame " << lastOccluded << " of "
+		<< lastTested << " boxes occluded (" << rate << "%)" << std::endl;
+}
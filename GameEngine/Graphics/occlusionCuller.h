@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class Mesh;
+
+//pixels per side of a max depth tile, widths and band heights are multiples of it
+#define OCCLUSION_TILE 8
+
+//Software occlusion culling on the CPU, no GL involved. Occluders are world space
+//triangles (walls, big rocks) rasterized every frame into a small depth buffer,
+//4 pixels per SSE step. The rows are split into bands, one per thread: every band
+//is written by exactly one thread and depth only ever takes the minimum, so the
+//result does not depend on the thread count or timing.
+//Depth is NDC z mapped to [0, 1]; each 8x8 tile also keeps its farthest depth
+//so most occludee tests never look at single pixels.
+class OcclusionCuller
+{
+public:
+	//width is rounded up to a multiple of OCCLUSION_TILE, height to one per band.
+	//workers threads help the calling thread, 0 rasterizes everything in render()
+	OcclusionCuller(unsigned int width, unsigned int height, unsigned int workers);
+	~OcclusionCuller();
+
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	//the largest budget triangles of the mesh under model. Dropping small ones only
+	//makes the culling less effective, never wrong. Needs CPU vertices
+	void addOccluder(const Mesh& mesh, const glm::mat4& model, unsigned int budget);
+	void addOccluder(const std::vector<glm::vec3>& positions, const std::vector<int>& indices,
+		const glm::mat4& model, unsigned int budget);
+	unsigned int getOccluderTriangles() const;
+
+	//clears the depth and rasterizes all occluders seen through viewProj
+	void render(const glm::mat4& viewProj);
+
+	//false only when the box is behind the occluders everywhere it covers
+	bool isVisible(const glm::vec3& low, const glm::vec3& high);
+	//the same test without counting, any number of threads can call it between two render()s.
+	//They add their counts afterwards
+	bool testBox(const glm::vec3& low, const glm::vec3& high) const;
+	void addCounts(unsigned int tested, unsigned int occluded);
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	const float* getDepth() const;
+
+	//tests and occluded boxes since the previous render(), raster time of the last one
+	unsigned int getTested() const;
+	unsigned int getOccluded() const;
+	double getRasterSeconds() const;
+	void printReport();
+
+private:
+	//edge functions are positive inside, depth is a plane over the screen
+	struct RasterTriangle
+	{
+		int minX, maxX, minY, maxY;
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+	};
+
+	void setup(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	void rasterizeBand(unsigned int band);
+	void workerLoop(unsigned int band);
+
+	unsigned int width, height, tilesX, tilesY;
+	unsigned int bandRows;
+	std::vector<float> depth;    // row major
+	std::vector<float> tileMax;  // farthest depth per tile
+
+	std::vector<glm::vec3> occluders; // three corners per triangle, world space
+	std::vector<RasterTriangle> triangles; // this frame's, after clipping
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	unsigned int generation, pending;
+	bool stopWorkers;
+
+	glm::mat4 viewProj;
+	unsigned int tested, occluded, lastTested, lastOccluded;
+	double rasterSeconds;
+};
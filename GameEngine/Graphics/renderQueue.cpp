@@ -0,0 +1,215 @@
+#include "renderQueue.h"
+#include "uniformBuffer.h"
+#include "glState.h"
+#include "cullingSet.h"
+#include "..\Model Loading\mesh.h"
+#include <iostream>
+
+#define KEY_PASS_BITS 4
+#define KEY_PROGRAM_BITS 10
+#define KEY_MATERIAL_BITS 16
+#define KEY_MESH_BITS 16
+#define KEY_DEPTH_BITS 18
+
+//opaque groups by state, the sky is a single object
+static const bool frontToBack[RENDER_PASSES] = { false, true };
+
+RenderQueue::RenderQueue() : farDistance(1.0f), culled(0), itemCount(0), culledCount(0), programSwitches(0), textureBinds(0) {}
+
+void RenderQueue::begin(const glm::vec3& cameraPos, float farDistance, const Frustum& frustum)
+{
+	this->cameraPos = cameraPos;
+	this->farDistance = farDistance;
+	this->frustum = frustum;
+	culled = 0;
+
+	items.clear();
+	entries.clear();
+	programs.clear();
+	materials.clear();
+	meshes.clear();
+}
+
+unsigned int RenderQueue::programId(const Shader* shader)
+{
+	for (unsigned int i = 0; i < programs.size(); i++)
+	{
+		if (programs[i] == shader)
+			return i;
+	}
+	programs.push_back(shader);
+	return programs.size() - 1;
+}
+
+unsigned int RenderQueue::materialId(const Mesh* mesh)
+{
+	for (unsigned int i = 0; i < materials.size(); i++)
+	{
+		const std::vector<Texture>& textures = materials[i]->textures;
+		if (textures.size() != mesh->textures.size())
+			continue;
+
+		unsigned int t = 0;
+		while (t < textures.size() && textures[t].id == mesh->textures[t].id)
+			t++;
+		if (t == textures.size())
+			return i;
+	}
+	materials.push_back(mesh);
+	return materials.size() - 1;
+}
+
+unsigned int RenderQueue::meshId(const Mesh* mesh)
+{
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i] == mesh)
+			return i;
+	}
+	meshes.push_back(mesh);
+	return meshes.size() - 1;
+}
+
+void RenderQueue::submit(RenderPass pass, Shader& shader, const Mesh& mesh, const glm::mat4& model)
+{
+	submit(pass, shader, mesh, model, glm::vec3(model[3]));
+}
+
+void RenderQueue::submit(RenderPass pass, Shader& shader, const Mesh& mesh, const glm::mat4& model, const glm::vec3& center,
+	float lodFade)
+{
+	//a handful of objects, the scalar tests are enough here
+	glm::vec3 boundsCenter, extent;
+	float radius;
+	CullingSet::transform(mesh, model, boundsCenter, extent, radius);
+	if (!frustum.intersects(boundsCenter, radius) || !frustum.intersects(boundsCenter - extent, boundsCenter + extent))
+	{
+		culled++;
+		return;
+	}
+
+	Item item;
+	item.shader = &shader;
+	item.mesh = &mesh;
+	item.material = materialId(&mesh);
+	item.model = model;
+	item.lodFade = lodFade;
+
+	float distance = glm::length(center - cameraPos) / farDistance;
+	uint64_t depth = (uint64_t)(glm::clamp(distance, 0.0f, 1.0f) * ((1 << KEY_DEPTH_BITS) - 1));
+	uint64_t program = programId(&shader) & ((1 << KEY_PROGRAM_BITS) - 1);
+	uint64_t material = item.material & ((1 << KEY_MATERIAL_BITS) - 1);
+	uint64_t object = meshId(&mesh) & ((1 << KEY_MESH_BITS) - 1);
+
+	uint64_t state = (program << (KEY_MATERIAL_BITS + KEY_MESH_BITS)) | (material << KEY_MESH_BITS) | object;
+	uint64_t key = (uint64_t)pass << (64 - KEY_PASS_BITS);
+	if (frontToBack[pass])
+		key |= (depth << (KEY_PROGRAM_BITS + KEY_MATERIAL_BITS + KEY_MESH_BITS)) | state;
+	else
+		key |= (state << KEY_DEPTH_BITS) | depth;
+
+	SortEntry entry;
+	entry.key = key;
+	entry.item = items.size();
+	entries.push_back(entry);
+	items.push_back(item);
+}
+
+//least significant digit first, 8 bits at a time, digits equal in every key are skipped
+void RenderQueue::sort()
+{
+	scratch.resize(entries.size());
+
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int counts[256] = {};
+		for (unsigned int i = 0; i < entries.size(); i++)
+			counts[(entries[i].key >> shift) & 0xff]++;
+
+		if (counts[(entries[0].key >> shift) & 0xff] == entries.size())
+			continue;
+
+		unsigned int offset = 0;
+		for (unsigned int d = 0; d < 256; d++)
+		{
+			unsigned int count = counts[d];
+			counts[d] = offset;
+			offset += count;
+		}
+
+		for (unsigned int i = 0; i < entries.size(); i++)
+			scratch[counts[(entries[i].key >> shift) & 0xff]++] = entries[i];
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::execute(UniformStream& objectUniforms)
+{
+	itemCount = items.size();
+	culledCount = culled;
+	programSwitches = 0;
+	textureBinds = 0;
+	if (items.empty())
+		return;
+
+	sort();
+
+	int pass = -1;
+	Shader* shader = NULL;
+	int material = -1;
+	const Mesh* mesh = NULL;
+
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		const Item& item = items[entries[i].item];
+
+		int itemPass = (int)(entries[i].key >> (64 - KEY_PASS_BITS));
+		if (itemPass != pass)
+		{
+			GLState::depthFunc(itemPass == RENDER_PASS_SKY ? GL_LEQUAL : GL_LESS);
+			pass = itemPass;
+		}
+
+		//textures and uniforms are looked up per program, a switch invalidates both
+		if (item.shader != shader)
+		{
+			item.shader->use();
+			shader = item.shader;
+			material = -1;
+			mesh = NULL;
+			programSwitches++;
+		}
+		if ((int)item.material != material)
+		{
+			item.mesh->bindTextures(*shader);
+			material = item.material;
+			textureBinds += item.mesh->textures.size();
+		}
+		if (item.mesh != mesh)
+		{
+			item.mesh->bindDequantization(*shader);
+			mesh = item.mesh;
+		}
+
+		if (item.lodFade != 0.0f)
+		{
+			static const uint32_t lodFadeName = Shader::hashName("lodFade");
+			Uniform fade = shader->getUniform(lodFadeName);
+			if (fade.isValid())
+				fade.set(item.lodFade);
+		}
+
+		objectUniforms.push(ObjectUniforms(item.model));
+		item.mesh->drawGeometry();
+	}
+
+	GLState::depthFunc(GL_LESS);
+	items.clear();
+	entries.clear();
+}
+
+void RenderQueue::printReport()
+{
+	std::cout << "Render queue: " << itemCount << " items (" << culledCount << " culled), " << programSwitches << " program switches, "
+		<< textureBinds << " texture binds" << std::endl;
+}
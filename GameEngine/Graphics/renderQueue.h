@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include <stdint.h>
+#include "frustum.h"
+
+class Mesh;
+class Shader;
+class UniformStream;
+
+//passes execute in this order
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE, // sorted by state, front to back inside one state
+	RENDER_PASS_SKY     // after the opaque pass so hidden sky pixels fail the depth test, GL_LEQUAL
+};
+
+#define RENDER_PASSES 2
+
+//Collects a frame's single-object draws and executes them as one stream sorted
+//by a 64 bit key. State-first passes use
+//  pass (4) | program (10) | material (16) | mesh (16) | depth (18)
+//front-to-back passes move the depth right after the pass.
+//Programs, materials (texture sets) and meshes get small ids in the order they
+//are first submitted, so each state change happens once per group.
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	//depth in the keys is the distance to cameraPos, quantized up to farDistance.
+	//Objects whose mesh bounds are outside the frustum are dropped on submit
+	void begin(const glm::vec3& cameraPos, float farDistance, const Frustum& frustum);
+	void submit(RenderPass pass, Shader& shader, const Mesh& mesh, const glm::mat4& model);
+	//depth measured at center instead of the model origin, for meshes already in world space.
+	//A non zero lodFade goes to the lodFade uniform of SHADER_LOD_DITHER variants
+	void submit(RenderPass pass, Shader& shader, const Mesh& mesh, const glm::mat4& model, const glm::vec3& center,
+		float lodFade = 0.0f);
+
+	//radix sorts the keys and draws everything, the object block comes from objectUniforms
+	void execute(UniformStream& objectUniforms);
+
+	void printReport();
+
+private:
+	struct Item
+	{
+		Shader* shader;
+		const Mesh* mesh;
+		unsigned int material;
+		glm::mat4 model;
+		float lodFade;
+	};
+
+	struct SortEntry
+	{
+		uint64_t key;
+		unsigned int item;
+	};
+
+	unsigned int programId(const Shader* shader);
+	unsigned int materialId(const Mesh* mesh);
+	unsigned int meshId(const Mesh* mesh);
+	void sort();
+
+	glm::vec3 cameraPos;
+	float farDistance;
+	Frustum frustum;
+	unsigned int culled;
+
+	std::vector<Item> items;
+	std::vector<SortEntry> entries, scratch;
+
+	std::vector<const Shader*> programs;
+	std::vector<const Mesh*> materials; // first mesh seen with each texture set
+	std::vector<const Mesh*> meshes;
+
+	unsigned int itemCount, culledCount, programSwitches, textureBinds; // last execute
+};
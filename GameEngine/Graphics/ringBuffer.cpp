@@ -0,0 +1,148 @@
+#include "ringBuffer.h"
+#include "glState.h"
+#include <iostream>
+
+unsigned int RingBuffer::currentFrame = 0;
+GLsync RingBuffer::fences[RING_FRAMES] = {};
+size_t RingBuffer::mappedBytes = 0;
+size_t RingBuffer::writtenBytes = 0;
+unsigned int RingBuffer::stalls = 0;
+unsigned int RingBuffer::grows = 0;
+
+static const unsigned int MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+RingBuffer::RingBuffer() : id(0), mapped(NULL), regionSize(0), alignment(1), used(0), frame(0) {}
+
+RingBuffer::~RingBuffer()
+{
+	if (id != 0)
+	{
+		//deleting a mapped buffer unmaps it
+		GLState::deleteBuffer(id);
+		mappedBytes -= (size_t)regionSize * RING_FRAMES;
+	}
+}
+
+bool RingBuffer::isSupported()
+{
+	return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+void RingBuffer::beginFrame()
+{
+	currentFrame++;
+
+	GLsync& fence = fences[currentFrame % RING_FRAMES];
+	if (fence == NULL)
+		return;
+
+	//the region was last used RING_FRAMES frames ago, a timeout here means the GPU is behind
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		stalls++;
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	fence = NULL;
+}
+
+void RingBuffer::endFrame()
+{
+	fences[currentFrame % RING_FRAMES] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RingBuffer::create(unsigned int regionSize, unsigned int alignment)
+{
+	this->alignment = alignment > 0 ? alignment : 1;
+	reserve(regionSize);
+}
+
+//new immutable storage, this frame's bytes are copied so handed out offsets stay valid
+void RingBuffer::reserve(unsigned int newRegionSize)
+{
+	if (newRegionSize < alignment)
+		newRegionSize = alignment;
+	newRegionSize = (newRegionSize + alignment - 1) / alignment * alignment;
+	while (newRegionSize % 256 != 0)
+		newRegionSize += alignment;
+
+	unsigned int newId;
+	glGenBuffers(1, &newId);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newId);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, (size_t)newRegionSize * RING_FRAMES, NULL, MAP_FLAGS);
+	char* newMapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (size_t)newRegionSize * RING_FRAMES, MAP_FLAGS);
+	if (newMapped == NULL)
+		std::cout << "Failed to map ring buffer" << std::endl;
+
+	if (id != 0)
+	{
+		if (frame == currentFrame && used > 0)
+		{
+			GLState::bindBuffer(GL_COPY_READ_BUFFER, id);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, getRegionStart(),
+				(size_t)(currentFrame % RING_FRAMES) * newRegionSize, used);
+		}
+		//frames still in flight keep the old storage alive until they finish
+		GLState::deleteBuffer(id);
+		mappedBytes -= (size_t)regionSize * RING_FRAMES;
+	}
+
+	id = newId;
+	mapped = newMapped;
+	regionSize = newRegionSize;
+	mappedBytes += (size_t)regionSize * RING_FRAMES;
+}
+
+void* RingBuffer::allocate(unsigned int size, unsigned int& offset)
+{
+	if (frame != currentFrame)
+	{
+		frame = currentFrame;
+		used = 0;
+	}
+
+	unsigned int start = (used + alignment - 1) / alignment * alignment;
+	if (start + size > regionSize)
+	{
+		unsigned int capacity = regionSize * 2;
+		while (capacity < start + size)
+			capacity *= 2;
+		reserve(capacity);
+		grows++;
+	}
+
+	used = start + size;
+	writtenBytes += size;
+
+	offset = start;
+	return mapped + getRegionStart() + start;
+}
+
+unsigned int RingBuffer::getId()
+{
+	return id;
+}
+
+unsigned int RingBuffer::getRegionStart()
+{
+	return (currentFrame % RING_FRAMES) * regionSize;
+}
+
+unsigned int RingBuffer::getUsed()
+{
+	return frame == currentFrame ? used : 0;
+}
+
+void RingBuffer::printReport()
+{
+	std::cout << "Ring buffers: " << mappedBytes / 1024 << " KB mapped, " << writtenBytes / 1024
+		<< " KB written, " << stalls << " fence stalls, " << grows << " grows" << std::endl;
+
+	writtenBytes = 0;
+	stalls = 0;
+	grows = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glew.h>
+
+//frames the CPU may run ahead of the GPU, every ring has one region per frame
+#define RING_FRAMES 3
+
+//Persistently and coherently mapped buffer split into RING_FRAMES regions.
+//Each frame writes straight into its own region, so streaming needs no
+//glBufferData/glBufferSubData and never syncs implicitly with the driver.
+//beginFrame() waits on the fence endFrame() placed RING_FRAMES frames ago,
+//which has normally long signalled by then.
+//Offsets from allocate() are relative to the frame's region. A full region grows
+//the ring into a new buffer with this frame's data copied over, so read
+//getId() and getRegionStart() after allocating.
+class RingBuffer
+{
+public:
+	RingBuffer();
+	~RingBuffer();
+
+	//owns a mapping, a copy would unmap and delete it a second time
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	//GL 4.4 or ARB_buffer_storage
+	static bool isSupported();
+
+	//bracket every frame, one fence covers all rings
+	static void beginFrame();
+	static void endFrame();
+
+	//allocations are aligned to alignment, region starts also to 256 (the largest GL buffer offset alignment)
+	void create(unsigned int regionSize, unsigned int alignment);
+
+	//returns the write pointer, offset receives the position in this frame's region
+	void* allocate(unsigned int size, unsigned int& offset);
+
+	unsigned int getId();
+	unsigned int getRegionStart();
+	unsigned int getUsed(); // bytes allocated this frame
+
+	static void printReport();
+
+private:
+	void reserve(unsigned int newRegionSize);
+
+	unsigned int id;
+	char* mapped;
+	unsigned int regionSize;
+	unsigned int alignment;
+	unsigned int used;
+	unsigned int frame; // frame the used bytes belong to
+
+	static unsigned int currentFrame;
+	static GLsync fences[RING_FRAMES];
+	static size_t mappedBytes, writtenBytes;
+	static unsigned int stalls, grows;
+};
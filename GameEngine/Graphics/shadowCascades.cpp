@@ -0,0 +1,337 @@
+#include "shadowCascades.h"
+#include "staticBatcher.h"
+#include "frustum.h"
+#include "glState.h"
+#include <../glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <iostream>
+
+//how far above the box center casters can be, meteors spawn 200 units up
+#define SHADOW_CASTER_HEIGHT 400.0f
+
+static GLuint createDepthArray(bool compare)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GLState::bindTexture(SHADOW_MAP_UNIT, texture, GL_TEXTURE_2D_ARRAY);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES,
+		0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+	if (compare)
+	{
+		//2x2 filtered comparison, outside the map is lit
+		const GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	else
+	{
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+	return texture;
+}
+
+ShadowCascades::ShadowCascades()
+	: refreshAngle(glm::radians(1.0f)), margin(0.25f), caching(true),
+	shader("Shaders/shadow_vertex_shader.glsl", "Shaders/shadow_fragment_shader.glsl"),
+	cache(0), map(0), cacheFramebuffer(0), mapFramebuffer(0), timer(0), timerPending(false), batches(NULL),
+	frames(0), refreshes(0), staticTriangles(0), dynamicTriangles(0), uncachedTriangles(0), timedFrames(0),
+	cpuSeconds(0.0), gpuSeconds(0.0)
+{
+	shader.use();
+	casterModel = shader.getUniform("casterModel");
+	lightViewProj = shader.getUniform("lightViewProj");
+
+	for (int i = 0; i < SHADOW_CASCADES; i++)
+	{
+		cascades[i].radius = 0.0f;
+		cascades[i].center = glm::vec3(0.0f);
+		cascades[i].sun = glm::vec3(0.0f, 1.0f, 0.0f);
+		cascades[i].viewProj = glm::mat4(1.0f);
+		cascades[i].triangles = 0;
+		cascades[i].valid = false;
+	}
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	if (cacheFramebuffer)
+		glDeleteFramebuffers(1, &cacheFramebuffer);
+	if (mapFramebuffer)
+		glDeleteFramebuffers(1, &mapFramebuffer);
+	if (cache)
+		glDeleteTextures(1, &cache);
+	if (map)
+		glDeleteTextures(1, &map);
+	if (timer)
+		glDeleteQueries(1, &timer);
+}
+
+void ShadowCascades::attach(GLuint framebuffer, GLuint texture, int layer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+}
+
+bool ShadowCascades::create(const float* splits)
+{
+	for (int i = 0; i < SHADOW_CASCADES; i++)
+		cascades[i].radius = splits[i];
+
+	cache = createDepthArray(false);
+	map = createDepthArray(true);
+
+	//depth only, no color buffers to read or draw
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	cacheFramebuffer = framebuffers[0];
+	mapFramebuffer = framebuffers[1];
+
+	bool complete = true;
+	for (int i = 0; i < 2; i++)
+	{
+		attach(framebuffers[i], i == 0 ? cache : map, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete)
+	{
+		std::cout << "Shadow map framebuffer is incomplete, shadows are off" << std::endl;
+		glDeleteFramebuffers(2, framebuffers);
+		cacheFramebuffer = 0;
+		mapFramebuffer = 0;
+		return false;
+	}
+
+	glGenQueries(1, &timer);
+	return true;
+}
+
+bool ShadowCascades::isCreated() const
+{
+	return mapFramebuffer != 0;
+}
+
+void ShadowCascades::setStaticCasters(const StaticBatcher* batches)
+{
+	this->batches = batches;
+	for (int i = 0; i < SHADOW_CASCADES; i++)
+		cascades[i].valid = false;
+}
+
+void ShadowCascades::addDynamic(const Mesh& mesh, const glm::mat4& model)
+{
+	Dynamic dynamic = { &mesh, model };
+	dynamics.push_back(dynamic);
+}
+
+bool ShadowCascades::needsRecenter(const Cascade& cascade, const glm::vec3& cameraPos) const
+{
+	return glm::length(cameraPos - cascade.center) > cascade.radius * margin;
+}
+
+//the box covers the split sphere from anywhere within the margin of its center
+void ShadowCascades::place(Cascade& cascade, const glm::vec3& cameraPos, const glm::vec3& sunDirection)
+{
+	float half = cascade.radius * (1.0f + margin);
+	float distance = half + SHADOW_CASTER_HEIGHT;
+	glm::vec3 up = std::abs(sunDirection.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	glm::mat4 view = glm::lookAt(cameraPos + sunDirection * distance, cameraPos, up);
+	glm::mat4 projection = glm::ortho(-half, half, -half, half, 0.0f, 2.0f * distance);
+
+	cascade.center = cameraPos;
+	cascade.sun = sunDirection;
+	cascade.viewProj = projection * view;
+}
+
+//far cascades draw coarser LOD levels, their texels are bigger than the lost detail
+unsigned int ShadowCascades::drawStatic(int index)
+{
+	if (batches == NULL)
+		return 0;
+
+	const Cascade& cascade = cascades[index];
+	Frustum frustum(cascade.viewProj);
+	lightViewProj.set(cascade.viewProj);
+	casterModel.set(glm::mat4(1.0f));
+
+	unsigned int triangles = 0;
+	const std::vector<StaticBatch>& all = batches->getBatches();
+	for (unsigned int i = 0; i < all.size(); i++)
+	{
+		const StaticBatch& batch = all[i];
+		if (!frustum.intersects(batch.low, batch.high)) continue;
+
+		const Mesh& mesh = batch.lod.getLevel(batch.mesh, glm::min(index, batch.lod.getLevelCount() - 1));
+		mesh.bindDequantization(shader);
+		mesh.drawGeometry();
+		triangles += mesh.indexCount / 3;
+	}
+	return triangles;
+}
+
+unsigned int ShadowCascades::drawDynamic(int index)
+{
+	lightViewProj.set(cascades[index].viewProj);
+
+	unsigned int triangles = 0;
+	for (unsigned int i = 0; i < dynamics.size(); i++)
+	{
+		casterModel.set(dynamics[i].model);
+		dynamics[i].mesh->bindDequantization(shader);
+		dynamics[i].mesh->drawGeometry();
+		triangles += dynamics[i].mesh->indexCount / 3;
+	}
+	return triangles;
+}
+
+void ShadowCascades::render(const glm::vec3& cameraPos, const glm::vec3& sunDirection)
+{
+	if (!isCreated())
+	{
+		dynamics.clear();
+		return;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	//one pass is timed at a time, its result is picked up once the GPU is done with it
+	if (timerPending)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(timer, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+			gpuSeconds += nanoseconds * 1e-9;
+			timedFrames++;
+			timerPending = false;
+		}
+	}
+	bool timing = !timerPending;
+	if (timing)
+		glBeginQuery(GL_TIME_ELAPSED, timer);
+
+	//the camera leaving a box can't wait, a turned sun can for all but the stalest cascades
+	bool refresh[SHADOW_CASCADES];
+	for (int i = 0; i < SHADOW_CASCADES; i++)
+		refresh[i] = !caching || !cascades[i].valid || needsRecenter(cascades[i], cameraPos);
+
+	for (int budget = 0; budget < SHADOW_REFRESHES_PER_FRAME; budget++)
+	{
+		int stalest = -1;
+		float stalestAngle = refreshAngle;
+		for (int i = 0; i < SHADOW_CASCADES; i++)
+		{
+			float angle = acos(glm::clamp(glm::dot(cascades[i].sun, sunDirection), -1.0f, 1.0f));
+			if (!refresh[i] && angle > stalestAngle)
+			{
+				stalest = i;
+				stalestAngle = angle;
+			}
+		}
+		if (stalest < 0)
+			break;
+		refresh[stalest] = true;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+	GLState::setEnabled(GL_DEPTH_TEST, true);
+	GLState::depthFunc(GL_LESS);
+	GLState::depthMask(true);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	shader.use();
+
+	for (int i = 0; i < SHADOW_CASCADES; i++)
+	{
+		Cascade& cascade = cascades[i];
+		attach(cacheFramebuffer, cache, i);
+		if (refresh[i])
+		{
+			place(cascade, cameraPos, sunDirection);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			cascade.triangles = drawStatic(i);
+			cascade.valid = true;
+			staticTriangles += cascade.triangles;
+			refreshes++;
+		}
+		uncachedTriangles += cascade.triangles;
+
+		//the cached depth is the starting point, the dynamic casters go on top with the same matrix
+		attach(mapFramebuffer, map, i);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, cacheFramebuffer);
+		glBlitFramebuffer(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		dynamicTriangles += drawDynamic(i);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	if (timing)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		timerPending = true;
+	}
+
+	dynamics.clear();
+	frames++;
+	cpuSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ShadowCascades::fillUniforms(FrameUniforms& frame) const
+{
+	//NDC to texture space
+	glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f));
+	bias = glm::scale(bias, glm::vec3(0.5f));
+
+	frame.shadowSplits = glm::vec4(0.0f);
+	for (int i = 0; i < SHADOW_CASCADES; i++)
+	{
+		frame.shadowMatrices[i] = bias * cascades[i].viewProj;
+		if (isCreated())
+			frame.shadowSplits[i] = cascades[i].radius;
+	}
+}
+
+void ShadowCascades::bind() const
+{
+	if (isCreated())
+		GLState::bindTexture(SHADOW_MAP_UNIT, map, GL_TEXTURE_2D_ARRAY);
+}
+
+void ShadowCascades::printReport()
+{
+	double frameCount = frames > 0 ? frames : 1;
+	std::cout << "Shadow cascades: " << SHADOW_CASCADES << "x" << SHADOW_MAP_SIZE << "^2, caching "
+		<< (caching ? "on" : "off") << ", " << refreshes << " cache refreshes over " << frames << " frames; per frame "
+		<< staticTriangles / frameCount << " static and " << dynamicTriangles / frameCount
+		<< " dynamic caster triangles (" << uncachedTriangles / frameCount << " static without the cache), "
+		<< cpuSeconds * 1000.0 / frameCount << " ms CPU, "
+		<< (timedFrames > 0 ? gpuSeconds * 1000.0 / timedFrames : 0.0) << " ms GPU" << std::endl;
+
+	frames = 0;
+	refreshes = 0;
+	staticTriangles = 0;
+	dynamicTriangles = 0;
+	uncachedTriangles = 0;
+	timedFrames = 0;
+	cpuSeconds = 0.0;
+	gpuSeconds = 0.0;
+}
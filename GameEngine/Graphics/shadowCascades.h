@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "uniformBuffer.h"
+#include "..\Shaders\shader.h"
+#include "..\Model Loading\mesh.h"
+
+class StaticBatcher;
+
+//texels per side of every cascade
+#define SHADOW_MAP_SIZE 2048
+//static casters are redrawn into at most this many cascades per frame when the sun moved;
+//the others keep their cached depth a little longer
+#define SHADOW_REFRESHES_PER_FRAME 1
+
+//Cascaded shadow maps of the sun, with the static casters cached. Every cascade is
+//a square light space box around a point near the camera covering everything within
+//its split distance. Static casters (the scenery batches) are drawn into a cached
+//depth layer only when the cascade is refreshed: the sun turned more than refreshAngle
+//since the last time (one cascade per frame, the stalest first) or the camera left
+//the margin around the box center (right away). Each frame the cached layers are
+//copied into the sampled map and the dynamic casters drawn on top of the copy with
+//the same matrices, so moving objects cost a few draws instead of the whole scene.
+//The lit shaders pick the cascade by distance, see FrameUniforms::shadowSplits.
+class ShadowCascades
+{
+public:
+	float refreshAngle; // radians
+	float margin;       // fraction of a cascade's radius the camera may move before it is recentered
+	bool caching;       // off redraws every static caster into every cascade each frame
+
+	ShadowCascades();
+	~ShadowCascades();
+
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	//split distances from the camera, ascending. False when the framebuffer is not supported,
+	//the lit shaders then see no cascades and stay unshadowed
+	bool create(const float* splits);
+	bool isCreated() const;
+
+	//the scenery batches never move; their LOD levels get coarser with the cascade
+	void setStaticCasters(const StaticBatcher* batches);
+
+	//dynamic casters of this frame, cleared by render()
+	void addDynamic(const Mesh& mesh, const glm::mat4& model);
+
+	//refreshes the stale caches, composites the dynamic casters and clears their list.
+	//sunDirection points towards the sun. Changes the framebuffer and viewport and restores them
+	void render(const glm::vec3& cameraPos, const glm::vec3& sunDirection);
+
+	//shadow matrices and splits for the lit shaders, zero splits while not created
+	void fillUniforms(FrameUniforms& frame) const;
+	//binds the sampled map to SHADOW_MAP_UNIT
+	void bind() const;
+
+	//average shadow pass cost per frame with the cache as it is and what redrawing the
+	//static casters every frame would cost, since the last report
+	void printReport();
+
+private:
+	struct Cascade
+	{
+		float radius;        // split distance, the box half size adds the margin
+		glm::vec3 center;    // of the cached box
+		glm::vec3 sun;       // direction the cache was drawn with
+		glm::mat4 viewProj;
+		unsigned int triangles; // static casters in the cache
+		bool valid;
+	};
+
+	bool needsRecenter(const Cascade& cascade, const glm::vec3& cameraPos) const;
+	void place(Cascade& cascade, const glm::vec3& cameraPos, const glm::vec3& sunDirection);
+	void attach(GLuint framebuffer, GLuint texture, int layer);
+	unsigned int drawStatic(int cascade);
+	unsigned int drawDynamic(int cascade);
+
+	Shader shader;
+	Uniform casterModel, lightViewProj;
+
+	GLuint cache, map;                 // depth arrays, one layer per cascade
+	GLuint cacheFramebuffer, mapFramebuffer;
+	GLuint timer;                      // GL_TIME_ELAPSED of one shadow pass
+	bool timerPending;
+
+	Cascade cascades[SHADOW_CASCADES];
+	const StaticBatcher* batches;
+
+	struct Dynamic
+	{
+		const Mesh* mesh;
+		glm::mat4 model;
+	};
+	std::vector<Dynamic> dynamics;
+
+	//since the last report
+	unsigned int frames, refreshes, staticTriangles, dynamicTriangles, uncachedTriangles;
+	unsigned int timedFrames;
+	double cpuSeconds, gpuSeconds;
+};
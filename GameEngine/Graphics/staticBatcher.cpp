@@ -0,0 +1,233 @@
+#include "staticBatcher.h"
+#include <map>
+#include <cmath>
+#include <iostream>
+
+//proxy cells along the longest side of a cluster
+#define HLOD_PROXY_GRID 64
+
+StaticBatcher::StaticBatcher(float cellSize)
+	: proxyDistance(600.0f), proxyHysteresis(0.1f), cellSize(cellSize), visibleCount(0), culledCount(0),
+	proxyCount(0), replacedBatches(0), replacedInstances(0), swaps(0) {}
+
+bool StaticBatcher::BatchKey::operator<(const BatchKey& other) const
+{
+	if (textures != other.textures)
+		return textures < other.textures;
+	if (cellX != other.cellX)
+		return cellX < other.cellX;
+	return cellZ < other.cellZ;
+}
+
+void StaticBatcher::add(const Mesh& mesh, const glm::mat4* models, unsigned int count)
+{
+	if (mesh.vertices.empty())
+	{
+		std::cout << "Static batch source has no CPU vertices, load it with MESH_RESIDENCY_FULL" << std::endl;
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Source source;
+		source.mesh = &mesh;
+		source.model = models[i];
+		sources.push_back(source);
+	}
+}
+
+//source vertices under model, appended to a merged mesh
+void StaticBatcher::append(const std::vector<Vertex>& vertices, const std::vector<int>& indices,
+	const glm::mat4& model, std::vector<Vertex>& mergedVertices, std::vector<int>& mergedIndices)
+{
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+	int base = mergedVertices.size();
+	for (unsigned int v = 0; v < vertices.size(); v++)
+	{
+		Vertex vertex = vertices[v];
+		vertex.pos = glm::vec3(model * glm::vec4(vertex.pos, 1.0f));
+		vertex.normals = glm::normalize(normalMatrix * vertex.normals);
+		mergedVertices.push_back(vertex);
+	}
+	for (unsigned int n = 0; n < indices.size(); n++)
+		mergedIndices.push_back(base + indices[n]);
+}
+
+void StaticBatcher::build()
+{
+	std::map<BatchKey, std::vector<unsigned int> > groups;
+	std::map<std::pair<int, int>, std::vector<unsigned int> > cells;
+	for (unsigned int i = 0; i < sources.size(); i++)
+	{
+		BatchKey key;
+		for (unsigned int t = 0; t < sources[i].mesh->textures.size(); t++)
+			key.textures.push_back(sources[i].mesh->textures[t].id);
+		key.cellX = (int)std::floor(sources[i].model[3].x / cellSize);
+		key.cellZ = (int)std::floor(sources[i].model[3].z / cellSize);
+		groups[key].push_back(i);
+		cells[std::make_pair(key.cellX, key.cellZ)].push_back(i);
+	}
+
+	//one HLOD cluster per cell, whatever the materials
+	std::map<std::pair<int, int>, unsigned int> cellClusters;
+	clusters.reserve(clusters.size() + cells.size());
+	for (std::map<std::pair<int, int>, std::vector<unsigned int> >::iterator cell = cells.begin(); cell != cells.end(); ++cell)
+	{
+		std::vector<const Mesh*> meshes;
+		std::vector<glm::mat4> models;
+		for (unsigned int i = 0; i < cell->second.size(); i++)
+		{
+			meshes.push_back(sources[cell->second[i]].mesh);
+			models.push_back(sources[cell->second[i]].model);
+		}
+
+		HlodCluster cluster;
+		cluster.proxy = hlod.build(meshes.data(), models.data(), meshes.size(), HLOD_PROXY_GRID, cluster.error);
+		cluster.low = cluster.proxy.boundsLow;
+		cluster.high = cluster.proxy.boundsHigh;
+		cluster.center = (cluster.low + cluster.high) * 0.5f;
+		cluster.radius = cluster.proxy.boundsRadius;
+		cluster.batchCount = 0;
+		cluster.instanceCount = cell->second.size();
+		cluster.active = false;
+
+		cellClusters[cell->first] = clusters.size();
+		clusterBounds.add(cluster.proxy, glm::mat4(1.0f));
+		clusters.push_back(std::move(cluster));
+	}
+
+	batches.reserve(batches.size() + groups.size());
+	std::map<std::pair<const Mesh*, int>, Simplified> simplified; // by grid
+
+	for (std::map<BatchKey, std::vector<unsigned int> >::iterator group = groups.begin(); group != groups.end(); ++group)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<int> indices;
+
+		for (unsigned int i = 0; i < group->second.size(); i++)
+		{
+			const Source& source = sources[group->second[i]];
+			append(source.mesh->vertices, source.mesh->indices, source.model, vertices, indices);
+		}
+
+		StaticBatch batch;
+		batch.low = vertices[0].pos;
+		batch.high = vertices[0].pos;
+		for (unsigned int v = 1; v < vertices.size(); v++)
+		{
+			batch.low = glm::min(batch.low, vertices[v].pos);
+			batch.high = glm::max(batch.high, vertices[v].pos);
+		}
+		batch.center = (batch.low + batch.high) * 0.5f;
+		batch.radius = glm::length(batch.high - batch.low) * 0.5f;
+		batch.instanceCount = group->second.size();
+		batch.cluster = cellClusters[std::make_pair(group->first.cellX, group->first.cellZ)];
+		clusters[batch.cluster].batchCount++;
+
+		//LOD levels merge the simplified sources, so the error follows each instance's
+		//size rather than the whole cell's. The error is the largest one after scaling
+		const Mesh& first = *sources[group->second[0]].mesh;
+		batch.lod.setSource(indices.size() / 3);
+		unsigned int previousTriangles = indices.size() / 3;
+		for (int grid = MESH_LOD_FIRST_GRID; grid >= 1 && batch.lod.getLevelCount() < MESH_LOD_LEVELS; grid /= 2)
+		{
+			std::vector<Vertex> levelVertices;
+			std::vector<int> levelIndices;
+			float error = 0.0f;
+			for (unsigned int i = 0; i < group->second.size(); i++)
+			{
+				const Source& source = sources[group->second[i]];
+				std::pair<const Mesh*, int> key(source.mesh, grid);
+				if (simplified.find(key) == simplified.end())
+				{
+					Simplified& copy = simplified[key];
+					copy.error = MeshLod::simplify(source.mesh->vertices, source.mesh->indices, grid, copy.vertices, copy.indices);
+				}
+				const Simplified& copy = simplified[key];
+				append(copy.vertices, copy.indices, source.model, levelVertices, levelIndices);
+
+				float scale = glm::max(glm::length(source.model[0]), glm::max(glm::length(source.model[1]), glm::length(source.model[2])));
+				error = glm::max(error, copy.error * scale);
+			}
+
+			unsigned int levelTriangles = levelIndices.size() / 3;
+			if (levelTriangles == 0)
+				break;
+			if (levelTriangles > previousTriangles * 3 / 4)
+				continue;
+			batch.lod.addLevel(std::move(levelVertices), std::move(levelIndices), first.textures, error);
+			previousTriangles = levelTriangles;
+		}
+
+		//the merged copy is only needed on the GPU
+		batch.mesh = Mesh(std::move(vertices), std::move(indices), first.textures, MESH_RESIDENCY_NONE);
+
+		//the merged mesh is in world space, its own bounds need no transform
+		bounds.add(batch.mesh, glm::mat4(1.0f));
+		batches.push_back(std::move(batch));
+	}
+
+	std::cout << "Static batching: " << sources.size() << " instances merged into " << groups.size() << " batches and "
+		<< cells.size() << " HLOD proxies" << std::endl;
+	sources.clear();
+}
+
+void StaticBatcher::cull(const Frustum& frustum, const glm::vec3& cameraPos, std::vector<StaticBatch*>& visible,
+	std::vector<const HlodCluster*>& proxies)
+{
+	//distance to the box, a camera inside a cell always gets its batches
+	for (unsigned int i = 0; i < clusters.size(); i++)
+	{
+		HlodCluster& cluster = clusters[i];
+		float distance = glm::length(glm::clamp(cameraPos, cluster.low, cluster.high) - cameraPos);
+		bool active = cluster.active ? distance > proxyDistance * (1.0f - proxyHysteresis) : distance > proxyDistance;
+		if (active != cluster.active)
+		{
+			cluster.active = active;
+			swaps++;
+		}
+	}
+
+	bounds.cull(frustum, indices);
+	culledCount = batches.size() - indices.size();
+
+	visible.clear();
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		if (!clusters[batches[indices[i]].cluster].active)
+			visible.push_back(&batches[indices[i]]);
+	}
+
+	clusterBounds.cull(frustum, indices);
+
+	proxies.clear();
+	replacedBatches = 0;
+	replacedInstances = 0;
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		const HlodCluster& cluster = clusters[indices[i]];
+		if (!cluster.active)
+			continue;
+		proxies.push_back(&cluster);
+		replacedBatches += cluster.batchCount;
+		replacedInstances += cluster.instanceCount;
+	}
+
+	visibleCount = visible.size();
+	proxyCount = proxies.size();
+}
+
+const std::vector<StaticBatch>& StaticBatcher::getBatches() const
+{
+	return batches;
+}
+
+void StaticBatcher::printReport()
+{
+	std::cout << "Static batches: " << visibleCount << " drawn, " << culledCount << " culled, " << proxyCount
+		<< " HLOD proxies drawn for " << replacedBatches << " batches (" << replacedInstances << " instances), "
+		<< swaps << " swaps since last report, " << hlod.getMaterialCount() << " materials in the atlas" << std::endl;
+
+	swaps = 0;
+}
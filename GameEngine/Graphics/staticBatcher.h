@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include "frustum.h"
+#include "cullingSet.h"
+#include "lodSelector.h"
+#include "hlodBuilder.h"
+#include "..\Model Loading\mesh.h"
+
+//merged geometry of one material in one grid cell, already in world space
+struct StaticBatch
+{
+	Mesh mesh; // the material's textures, drawn with an identity model matrix
+	glm::vec3 low, high; // world space bounds
+	glm::vec3 center;
+	float radius;
+	unsigned int instanceCount;
+	MeshLod lod; // every source simplified on its own, then merged like mesh
+	LodState lodState;
+	unsigned int cluster; // HlodCluster of the batch's cell
+};
+
+//every instance of one grid cell in a single simplified mesh with one texture,
+//drawn instead of the cell's batches while the camera is far away
+struct HlodCluster
+{
+	Mesh proxy; // world space, identity model matrix
+	glm::vec3 low, high;
+	glm::vec3 center;
+	float radius;
+	float error; // world units, of the proxy against the sources
+	unsigned int batchCount, instanceCount;
+	bool active; // the proxy is drawn, not the batches
+};
+
+//Pre-transforms instances that never move into one mesh per material (texture set)
+//and grid cell at load time, so the scenery is a handful of draws culled per cell.
+//Sources need their CPU vertices (MESH_RESIDENCY_FULL) until build(), after that
+//they can drop them.
+//Each cell is also an HLOD cluster: once the camera is farther than proxyDistance
+//from the cell's box, one proxy draw replaces all of the cell's batches. It
+//switches back under proxyDistance * (1 - proxyHysteresis).
+class StaticBatcher
+{
+public:
+	float proxyDistance;
+	float proxyHysteresis;
+
+	//cells are square on the ground plane, instances are binned by their origin
+	StaticBatcher(float cellSize);
+
+	void add(const Mesh& mesh, const glm::mat4* models, unsigned int count);
+	//merges everything added so far and clears the sources
+	void build();
+
+	//swaps the clusters for the camera, then the batches of near cells and the proxies
+	//of far ones intersecting the frustum, in build order
+	void cull(const Frustum& frustum, const glm::vec3& cameraPos, std::vector<StaticBatch*>& visible,
+		std::vector<const HlodCluster*>& proxies);
+
+	//every batch, for passes that cull on their own (shadow maps)
+	const std::vector<StaticBatch>& getBatches() const;
+
+	void printReport();
+
+private:
+	struct Source
+	{
+		const Mesh* mesh;
+		glm::mat4 model;
+	};
+
+	struct BatchKey
+	{
+		std::vector<unsigned int> textures;
+		int cellX, cellZ;
+
+		bool operator<(const BatchKey& other) const;
+	};
+
+	//a source mesh simplified once for all its instances
+	struct Simplified
+	{
+		std::vector<Vertex> vertices;
+		std::vector<int> indices;
+		float error;
+	};
+
+	static void append(const std::vector<Vertex>& vertices, const std::vector<int>& indices,
+		const glm::mat4& model, std::vector<Vertex>& mergedVertices, std::vector<int>& mergedIndices);
+
+	float cellSize;
+	std::vector<Source> sources;
+	std::vector<StaticBatch> batches;
+	CullingSet bounds; // one entry per batch
+	std::vector<unsigned int> indices; // last cull
+
+	HlodBuilder hlod;
+	std::vector<HlodCluster> clusters;
+	CullingSet clusterBounds; // one entry per cluster
+
+	unsigned int visibleCount, culledCount, proxyCount, replacedBatches, replacedInstances; // last cull
+	unsigned int swaps; // since the last report
+};
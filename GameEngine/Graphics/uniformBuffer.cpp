@@ -0,0 +1,36 @@
+#include "uniformBuffer.h"
+#include "glState.h"
+#include <string.h>
+
+static unsigned int uniformAlignment()
+{
+	int align = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	return align > 0 ? align : 256;
+}
+
+void UniformBuffer::create(unsigned int size, unsigned int binding)
+{
+	this->binding = binding;
+	ring.create(size, uniformAlignment());
+}
+
+void UniformBuffer::update(const void* data, unsigned int size)
+{
+	unsigned int offset;
+	memcpy(ring.allocate(size, offset), data, size);
+	GLState::bindBufferRange(GL_UNIFORM_BUFFER, binding, ring.getId(), ring.getRegionStart() + offset, size);
+}
+
+void UniformStream::create(unsigned int capacity, unsigned int binding)
+{
+	this->binding = binding;
+	ring.create(capacity, uniformAlignment());
+}
+
+void UniformStream::push(const void* data, unsigned int size)
+{
+	unsigned int offset;
+	memcpy(ring.allocate(size, offset), data, size);
+	GLState::bindBufferRange(GL_UNIFORM_BUFFER, binding, ring.getId(), ring.getRegionStart() + offset, size);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include "ringBuffer.h"
+
+//fixed binding points shared by every shader, see Shader::reflect
+#define FRAME_BLOCK_BINDING 0
+#define OBJECT_BLOCK_BINDING 1
+//shader storage bindings of the ObjectRecords and DynamicRecords arrays, see IndirectRenderer
+#define OBJECT_STORAGE_BINDING 2
+#define DYNAMIC_STORAGE_BINDING 3
+//texture unit of the sun's shadow map array, outside the units Shader::reflect hands out in order
+#define SHADOW_MAP_UNIT 15
+
+//cascades of the sun's shadow map, see ShadowCascades
+#define SHADOW_CASCADES 3
+
+//std140 mirror of the FrameData block, written once per frame
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProj;
+	glm::vec4 lightPos;
+	glm::vec4 lightColor;
+	glm::vec4 viewPos;
+	glm::vec4 time; // x = seconds, y = day factor, z = sun angle, w = delta time
+	glm::vec4 fogColor; // rgb = colour, a = density (FOG variants only)
+	glm::mat4 shadowMatrices[SHADOW_CASCADES]; // world to shadow map texture space
+	glm::vec4 shadowSplits; // xyz = cascade far distances from the camera, 0 without shadows
+};
+
+//std140 mirror of the ObjectData block, written per draw
+struct ObjectUniforms
+{
+	glm::mat4 model;
+	glm::mat4 normalMatrix; // only the upper 3x3 is used
+
+	//the normal matrix is computed once here instead of per vertex in the shader
+	ObjectUniforms(const glm::mat4& model)
+		: model(model), normalMatrix(glm::transpose(glm::inverse(glm::mat3(model)))) {}
+};
+
+//one block bound to a fixed binding point, each update writes a new ring range
+class UniformBuffer
+{
+public:
+	void create(unsigned int size, unsigned int binding);
+	void update(const void* data, unsigned int size);
+
+private:
+	RingBuffer ring;
+	unsigned int binding;
+};
+
+//per-draw blocks written into the frame's ring region, every push binds its own range
+class UniformStream
+{
+public:
+	void create(unsigned int capacity, unsigned int binding); // capacity per frame
+	void push(const void* data, unsigned int size);
+
+	template <class T>
+	void push(const T& block) { push(&block, sizeof(T)); }
+
+private:
+	RingBuffer ring;
+	unsigned int binding;
+};
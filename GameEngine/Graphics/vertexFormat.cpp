@@ -0,0 +1,92 @@
+#include "vertexFormat.h"
+#include "..\Model Loading\mesh.h"
+#include <string.h>
+
+static int16_t toSnorm16(float value)
+{
+	value = glm::clamp(value, -1.0f, 1.0f);
+	return (int16_t)(value * 32767.0f + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+//octahedral mapping: project on |x|+|y|+|z| = 1 and fold the lower half over the diagonals
+Snorm16x2 encodeOctahedral(const glm::vec3& normal)
+{
+	Snorm16x2 encoded = { 0, 0 };
+
+	float sum = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+	if (sum == 0.0f)
+		return encoded;
+
+	glm::vec2 p = glm::vec2(normal.x, normal.y) / sum;
+	if (normal.z < 0.0f)
+	{
+		glm::vec2 folded = glm::vec2(1.0f - glm::abs(p.y), 1.0f - glm::abs(p.x));
+		p.x = p.x >= 0.0f ? folded.x : -folded.x;
+		p.y = p.y >= 0.0f ? folded.y : -folded.y;
+	}
+
+	encoded.x = toSnorm16(p.x);
+	encoded.y = toSnorm16(p.y);
+	return encoded;
+}
+
+//round to nearest, no denormals, out of range values clamp to the largest half
+uint16_t toHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (exponent <= 0)
+		return sign;
+	if (exponent >= 31)
+		return sign | 0x7bff;
+
+	uint16_t half = sign | (uint16_t)(exponent << 10) | (uint16_t)(mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+	return half;
+}
+
+void packVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex>& packed, glm::vec4& dequantize)
+{
+	packed.resize(vertices.size());
+	if (vertices.empty())
+	{
+		dequantize = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		return;
+	}
+
+	glm::vec3 low = vertices[0].pos;
+	glm::vec3 high = vertices[0].pos;
+	for (unsigned int i = 1; i < vertices.size(); i++)
+	{
+		low = glm::min(low, vertices[i].pos);
+		high = glm::max(high, vertices[i].pos);
+	}
+
+	//one scale for all axes keeps normals valid without touching the normal matrix
+	glm::vec3 center = (low + high) * 0.5f;
+	glm::vec3 extent = (high - low) * 0.5f;
+	float scale = glm::max(extent.x, glm::max(extent.y, extent.z));
+	if (scale <= 0.0f)
+		scale = 1.0f;
+	dequantize = glm::vec4(center, scale);
+
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		glm::vec3 p = (vertices[i].pos - center) / scale;
+		packed[i].position.x = toSnorm16(p.x);
+		packed[i].position.y = toSnorm16(p.y);
+		packed[i].position.z = toSnorm16(p.z);
+		packed[i].position.w = 0;
+
+		packed[i].normal = encodeOctahedral(vertices[i].normals);
+
+		packed[i].textureCoords.x = toHalf(vertices[i].textureCoords.x);
+		packed[i].textureCoords.y = toHalf(vertices[i].textureCoords.y);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Vertex;
+
+//attribute storage types, each one described by AttributeTraits
+struct Snorm16x4
+{
+	int16_t x, y, z, w;
+};
+
+struct Snorm16x2
+{
+	int16_t x, y;
+};
+
+struct Half2
+{
+	uint16_t x, y;
+};
+
+//how a member type is fed to glVertexAttribPointer
+template <class T> struct AttributeTraits;
+
+template <> struct AttributeTraits<glm::vec2> { enum { components = 2, type = GL_FLOAT, normalized = GL_FALSE }; };
+template <> struct AttributeTraits<glm::vec3> { enum { components = 3, type = GL_FLOAT, normalized = GL_FALSE }; };
+template <> struct AttributeTraits<Snorm16x4> { enum { components = 4, type = GL_SHORT, normalized = GL_TRUE }; };
+template <> struct AttributeTraits<Snorm16x2> { enum { components = 2, type = GL_SHORT, normalized = GL_TRUE }; };
+template <> struct AttributeTraits<Half2> { enum { components = 2, type = GL_HALF_FLOAT, normalized = GL_FALSE }; };
+
+//one attribute: shader location, member type and its offset in the vertex
+template <unsigned int Location, class T, size_t Offset>
+struct VertexAttribute
+{
+	static void apply(int stride)
+	{
+		glEnableVertexAttribArray(Location);
+		glVertexAttribPointer(Location, AttributeTraits<T>::components, AttributeTraits<T>::type,
+			AttributeTraits<T>::normalized, stride, (void*)Offset);
+	}
+};
+
+//a vertex type and all its attributes, apply() expands to the glVertexAttribPointer calls
+template <class V, class... Attributes>
+struct VertexLayout
+{
+	typedef V VertexType;
+
+	static void apply()
+	{
+		int expand[] = { 0, (Attributes::apply(sizeof(V)), 0)... };
+		(void)expand;
+	}
+};
+
+//16 bytes: position dequantized per mesh, octahedral normal, half float uv
+struct PackedVertex
+{
+	Snorm16x4 position; // (pos - dequantize.xyz) / dequantize.w, w unused
+	Snorm16x2 normal;
+	Half2 textureCoords;
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay tightly packed");
+
+typedef VertexLayout<PackedVertex,
+	VertexAttribute<0, Snorm16x4, offsetof(PackedVertex, position)>,
+	VertexAttribute<1, Snorm16x2, offsetof(PackedVertex, normal)>,
+	VertexAttribute<2, Half2, offsetof(PackedVertex, textureCoords)>> PackedVertexLayout;
+
+//converts loaded vertices to the packed format, dequantize is (center, scale) for the shader
+void packVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex>& packed, glm::vec4& dequantize);
+
+Snorm16x2 encodeOctahedral(const glm::vec3& normal);
+uint16_t toHalf(float value);
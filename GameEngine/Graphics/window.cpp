@@ -82,6 +82,21 @@ GLFWwindow* Window::getWindow()
 	return window;
 }
 
+//hidden window whose context shares objects with the main one, for worker threads
+GLFWwindow* Window::createSharedContext()
+{
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* context = glfwCreateWindow(1, 1, name, NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (context == NULL)
+	{
+		std::cout << "Failed to create a shared GL context" << std::endl;
+	}
+
+	return context;
+}
+
 int Window::getWidth()
 {
 	return width;
@@ -27,6 +27,7 @@ public:
 	Window(char* name, int width, int height);
 	~Window();
 	GLFWwindow* getWindow();
+	GLFWwindow* createSharedContext();
 
 	void init();
 	void update();
@@ -0,0 +1,65 @@
+#include "assets.h"
+#include "..\Shaders\programCache.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string.h>
+
+#include "..\Generated\embeddedAssetData.h"
+
+#ifdef ASSETS_FROM_DISK
+bool Assets::diskOverride = true;
+#else
+bool Assets::diskOverride = false;
+#endif
+
+const EmbeddedAsset* Assets::find(const char* path)
+{
+	for (const EmbeddedAsset* asset = generatedAssets; asset->path != NULL; asset++)
+	{
+		if (strcmp(asset->path, path) == 0)
+			return asset;
+	}
+	return NULL;
+}
+
+bool Assets::read(const char* path, std::string& data, uint64_t* hash)
+{
+	if (!diskOverride)
+	{
+		const EmbeddedAsset* asset = find(path);
+		if (asset)
+		{
+			data.assign((const char*)asset->data, asset->size);
+			if (hash)
+				*hash = asset->hash;
+			return true;
+		}
+	}
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.good())
+	{
+		std::cout << "Asset not found: " << path << std::endl;
+		data.clear();
+		return false;
+	}
+
+	std::stringstream stream;
+	stream << file.rdbuf();
+	data = stream.str();
+
+	if (hash)
+		*hash = ProgramCache::hash(data);
+	return true;
+}
+
+void Assets::setDiskOverride(bool enabled)
+{
+	diskOverride = enabled;
+}
+
+bool Assets::getDiskOverride()
+{
+	return diskOverride;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+//file compiled into the executable by Tools/embedAssets.ps1
+struct EmbeddedAsset
+{
+	const char* path;
+	const unsigned char* data;
+	unsigned int size;
+	uint64_t hash; // content hash computed at build time
+};
+
+//reads game files from the embedded table, or from disk for files that are
+//not embedded and while the development override is on
+class Assets
+{
+public:
+	static bool read(const char* path, std::string& data, uint64_t* hash = NULL);
+	static const EmbeddedAsset* find(const char* path);
+
+	//read everything from disk again, for editing shaders without rebuilding
+	//(on from startup when built with ASSETS_FROM_DISK)
+	static void setDiskOverride(bool enabled);
+	static bool getDiskOverride();
+
+private:
+	static bool diskOverride;
+};
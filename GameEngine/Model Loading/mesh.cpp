@@ -1,36 +1,152 @@
 #include "mesh.h"
+#include "..\Graphics\glState.h"
+#include <utility>
 
-Mesh::Mesh() {}
+#ifdef _DEBUG
+MeshResidency Mesh::defaultResidency = MESH_RESIDENCY_FULL;
+#else
+MeshResidency Mesh::defaultResidency = MESH_RESIDENCY_NONE;
+#endif
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<int> indices)
+static unsigned int residentMeshes[MESH_RESIDENCY_COUNT] = {};
+static size_t residentBytes[MESH_RESIDENCY_COUNT] = {};
+
+Mesh::Mesh() : geometry(0), vertexCount(0), indexCount(0), boundingRadius(0.0f), boundsLow(0.0f), boundsHigh(0.0f),
+	boundsRadius(0.0f), residency(MESH_RESIDENCY_NONE) {}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<int> indices, MeshResidency residency)
+	: vertices(std::move(vertices)), indices(std::move(indices))
+{
+	computeBounds();
+	setup(residency);
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<int> indices, std::vector<Texture> textures, MeshResidency residency)
+	: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
+{
+	updateSamplerNames();
+	computeBounds();
+	setup(residency);
+}
+
+Mesh::Mesh(Mesh&& other)
+	: vertices(std::move(other.vertices)), positions(std::move(other.positions)), indices(std::move(other.indices)),
+	textures(std::move(other.textures)), samplerNames(std::move(other.samplerNames)), geometry(other.geometry),
+	vertexCount(other.vertexCount), indexCount(other.indexCount), boundingRadius(other.boundingRadius),
+	boundsLow(other.boundsLow), boundsHigh(other.boundsHigh), boundsRadius(other.boundsRadius), residency(other.residency)
 {
-	this->vertices = vertices;
-	this->indices = indices;
+	other.geometry = 0;
+}
+
+Mesh& Mesh::operator=(Mesh&& other)
+{
+	if (this != &other)
+	{
+		release();
+
+		vertices = std::move(other.vertices);
+		positions = std::move(other.positions);
+		indices = std::move(other.indices);
+		textures = std::move(other.textures);
+		samplerNames = std::move(other.samplerNames);
+		geometry = other.geometry;
+		vertexCount = other.vertexCount;
+		indexCount = other.indexCount;
+		boundingRadius = other.boundingRadius;
+		boundsLow = other.boundsLow;
+		boundsHigh = other.boundsHigh;
+		boundsRadius = other.boundsRadius;
+		residency = other.residency;
+
+		other.geometry = 0;
+	}
+	return *this;
+}
 
-	setup2();
+Mesh::~Mesh()
+{
+	release();
 }
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<int> indices, std::vector<Texture> textures)
+void Mesh::release()
 {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->textures = textures;
+	account(false);
 
-	setup();
+	//moved-from meshes hold handle 0, which the arena ignores
+	GeometryArena::release(geometry);
+	geometry = 0;
+}
+
+//only meshes owning an arena range are counted, moved-from ones are skipped
+void Mesh::account(bool add) const
+{
+	if (geometry == 0)
+		return;
+
+	if (add)
+	{
+		residentMeshes[residency]++;
+		residentBytes[residency] += getCpuBytes();
+	}
+	else
+	{
+		residentMeshes[residency]--;
+		residentBytes[residency] -= getCpuBytes();
+	}
+}
+
+void Mesh::bindMaterial(const Shader& shader) const
+{
+	bindDequantization(shader);
+	bindTextures(shader);
+}
+
+//per mesh program state, reset by every program switch
+void Mesh::bindDequantization(const Shader& shader) const
+{
+	static const uint32_t dequantName = Shader::hashName("meshDequant");
+	Uniform dequant = shader.getUniform(dequantName);
+	if (dequant.isValid())
+		dequant.set(GeometryArena::getRange(geometry).dequantize);
+}
+
+//the samplers have fixed units after linking, unknown names fall back to unit i
+void Mesh::bindTextures(const Shader& shader) const
+{
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		int unit = shader.getSamplerUnit(samplerNames[i]);
+		if (unit < 0)
+			unit = i;
+
+		GLState::bindTexture(unit, textures[i].id);
+	}
+}
+
+void Mesh::drawGeometry() const
+{
+	//the shared VAO stays bound between meshes
+	GeometryArena::draw(geometry);
 }
 
 // render the mesh
-void Mesh::draw(Shader shader)
+void Mesh::draw(const Shader& shader) const
+{
+	bindMaterial(shader);
+	drawGeometry();
+}
+
+//sampler names only change with the textures, so they are built here and not per draw
+void Mesh::updateSamplerNames()
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
 	unsigned int normalNr = 1;
 	unsigned int heightNr = 1;
 
+	samplerNames.clear();
 	for (unsigned int i = 0; i < textures.size(); i++)
 	{
-		glActiveTexture(GL_TEXTURE0 + i); 
-											
 		std::string number;
 		std::string name = textures[i].type;
 		if (name == "texture_diffuse")
@@ -42,69 +158,87 @@ void Mesh::draw(Shader shader)
 		else if (name == "texture_height")
 			number = std::to_string(heightNr++); 
 
-		glUniform1i(glGetUniformLocation(shader.getId(), (name + number).c_str()), i);
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		samplerNames.push_back(Shader::hashName((name + number).c_str()));
 	}
+}
 
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+void Mesh::computeBounds()
+{
+	boundingRadius = 0.0f;
+	boundsLow = boundsHigh = vertices.empty() ? glm::vec3(0.0f) : vertices[0].pos;
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		boundingRadius = glm::max(boundingRadius, glm::length(vertices[i].pos));
+		boundsLow = glm::min(boundsLow, vertices[i].pos);
+		boundsHigh = glm::max(boundsHigh, vertices[i].pos);
+	}
 
-	glActiveTexture(GL_TEXTURE0);
+	//tighter than half the box diagonal for most shapes
+	glm::vec3 center = (boundsLow + boundsHigh) * 0.5f;
+	boundsRadius = 0.0f;
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		boundsRadius = glm::max(boundsRadius, glm::length(vertices[i].pos - center));
 }
 
-void Mesh::setup()
+//uploads the geometry once into the shared arena, called only from the constructors
+void Mesh::setup(MeshResidency residency)
 {
-	//create buffers
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
-	glGenBuffers(1, &ibo);
+	geometry = GeometryArena::allocate(vertices, indices);
+	vertexCount = vertices.size();
+	indexCount = indices.size();
 
-	//bind buffers
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	this->residency = MESH_RESIDENCY_FULL;
+	account(true);
+	setResidency(residency);
+}
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+void Mesh::setResidency(MeshResidency residency)
+{
+	if (residency > this->residency)
+	{
+		std::cout << "Mesh CPU data was already released, residency stays " << this->residency << std::endl;
+		return;
+	}
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normals));
+	account(false);
 
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, textureCoords));
+	//swapping with an empty vector gives the memory back, clear() would keep the capacity
+	if (residency == MESH_RESIDENCY_POSITIONS && this->residency == MESH_RESIDENCY_FULL)
+	{
+		positions.resize(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++)
+			positions[i] = vertices[i].pos;
+	}
+	if (residency != MESH_RESIDENCY_FULL)
+		std::vector<Vertex>().swap(vertices);
+	if (residency == MESH_RESIDENCY_NONE)
+	{
+		std::vector<glm::vec3>().swap(positions);
+		std::vector<int>().swap(indices);
+	}
 
-	glBindVertexArray(0);
+	this->residency = residency;
+	account(true);
 }
 
-//no textures yet
-void Mesh::setup2()
+size_t Mesh::getCpuBytes() const
 {
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
-	glGenBuffers(1, &ibo);
-
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	return vertices.capacity() * sizeof(Vertex) + positions.capacity() * sizeof(glm::vec3) + indices.capacity() * sizeof(int);
+}
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+void Mesh::printMemoryReport()
+{
+	static const char* names[MESH_RESIDENCY_COUNT] = { "none", "positions", "full" };
 
-	glBindVertexArray(0);
+	std::cout << "Mesh CPU copies:";
+	for (unsigned int i = 0; i < MESH_RESIDENCY_COUNT; i++)
+		std::cout << " " << residentMeshes[i] << " " << names[i] << " (" << residentBytes[i] / 1024 << " KB)";
+	std::cout << std::endl;
 }
 
+//material only, the buffers stay as they are
 void Mesh::setTextures(std::vector<Texture> textures)
 {
-	this->textures = textures;
-	setup();
+	this->textures = std::move(textures);
+	updateSamplerNames();
 }
-
-Mesh::~Mesh() {}
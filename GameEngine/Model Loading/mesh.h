@@ -6,6 +6,7 @@
 #include <iostream>
 #include <vector>
 #include "..\Shaders\shader.h"
+#include "..\Graphics\geometryArena.h"
 
 struct Vertex 
 {
@@ -64,22 +65,68 @@ struct Texture
 	std::string type;
 };
 
+//what a mesh keeps in RAM once its geometry is in the arena
+enum MeshResidency
+{
+	MESH_RESIDENCY_NONE,      // the arena holds the only copy
+	MESH_RESIDENCY_POSITIONS, // positions and indices, for collision and picking
+	MESH_RESIDENCY_FULL       // vertices and indices as loaded, for tools
+};
+
+#define MESH_RESIDENCY_COUNT 3
+
+//Owns its range of the GeometryArena: move-only, the range is released with the mesh.
+//Textures are material state and never touch the buffers.
+//The CPU copies are trimmed to the residency right after the upload.
 class Mesh
 {
 	public:
-		std::vector<Vertex> vertices;
-		std::vector<int> indices;
+		std::vector<Vertex> vertices;       // MESH_RESIDENCY_FULL only
+		std::vector<glm::vec3> positions;   // MESH_RESIDENCY_POSITIONS only
+		std::vector<int> indices;           // empty with MESH_RESIDENCY_NONE
 		std::vector<Texture> textures;
+		std::vector<uint32_t> samplerNames; //hashed "texture_diffuse1", ... per texture
+
+		unsigned int geometry; //GeometryArena handle, 0 when empty or moved from
+		unsigned int vertexCount, indexCount; //as uploaded, whatever the residency
+		float boundingRadius; //around the model origin, in model space
+		glm::vec3 boundsLow, boundsHigh; //model space box, for culling
+		float boundsRadius; //around the box center
+		MeshResidency residency;
 
-		unsigned int vao, vbo, ibo;
+		//debug builds keep everything, release builds drop the CPU copies
+		static MeshResidency defaultResidency;
 
 		Mesh();	
-		Mesh(std::vector<Vertex> vertices, std::vector<int> indices, std::vector<Texture> textures);
-		Mesh(std::vector<Vertex> vertices, std::vector<int> indices);
+		Mesh(std::vector<Vertex> vertices, std::vector<int> indices, std::vector<Texture> textures,
+			MeshResidency residency = defaultResidency);
+		Mesh(std::vector<Vertex> vertices, std::vector<int> indices, MeshResidency residency = defaultResidency);
+		Mesh(Mesh&& other);
+		Mesh& operator=(Mesh&& other);
 		~Mesh();
 
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
+
 		void setTextures(std::vector<Texture> textures);
-		void setup();
-		void setup2();
-		void draw(Shader shader);
+		//textures and the position dequantization of the arena range
+		void bindMaterial(const Shader& shader) const;
+		void bindTextures(const Shader& shader) const;
+		void bindDequantization(const Shader& shader) const;
+		void drawGeometry() const;
+		void draw(const Shader& shader) const;
+
+		//can only drop data, a mesh can't get back what it already released
+		void setResidency(MeshResidency residency);
+		size_t getCpuBytes() const;
+
+		//meshes and CPU bytes per residency
+		static void printMemoryReport();
+
+	private:
+		void setup(MeshResidency residency);
+		void release();
+		void account(bool add) const;
+		void updateSamplerNames();
+		void computeBounds();
 };
\ No newline at end of file
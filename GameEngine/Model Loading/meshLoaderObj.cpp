@@ -1,20 +1,23 @@
 #include "meshLoaderObj.h"
 #include "stringTokenizer.h"
+#include "assets.h"
+#include <sstream>
 
 MeshLoaderObj::MeshLoaderObj() {};
 
-Mesh MeshLoaderObj::loadObj(const std::string &filename)
+Mesh MeshLoaderObj::loadObj(const std::string &filename, MeshResidency residency)
 {
 	std::vector<Vertex> vertices;
 	std::vector<int> indices;
 
 	//Reading Obj file
-	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
-	if (!file.good())
+	std::string contents;
+	if (!Assets::read(filename.c_str(), contents))
 	{
 		std::cout << "Obj model not found " << filename << std::endl;
 		std::terminate();
 	}
+	std::istringstream file(contents);
 
 	std::string line;
 	std::vector<std::string> tokens, facetokens;
@@ -150,15 +153,14 @@ Mesh MeshLoaderObj::loadObj(const std::string &filename)
 
 	std::cout << "Loading:  " << filename << std::endl;
 
-	Mesh mesh(vertices, indices);
-
-	return mesh;
+	//the vectors and the GL buffers move into the result, nothing is copied or re-uploaded
+	return Mesh(std::move(vertices), std::move(indices), residency);
 }
 
-Mesh MeshLoaderObj::loadObj(const std::string &filename, std::vector<Texture> textures)
+Mesh MeshLoaderObj::loadObj(const std::string &filename, std::vector<Texture> textures, MeshResidency residency)
 {
-	Mesh mesh = loadObj(filename);
-	mesh.setTextures(textures);
+	Mesh mesh = loadObj(filename, residency);
+	mesh.setTextures(std::move(textures));
 
 	return mesh;
 }
\ No newline at end of file
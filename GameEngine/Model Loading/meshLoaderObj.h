@@ -12,7 +12,7 @@ class MeshLoaderObj
 {
 	public:
 		MeshLoaderObj();
-		Mesh loadObj(const std::string &filename, std::vector<Texture> textures);
-		Mesh loadObj(const std::string &filename);
+		Mesh loadObj(const std::string &filename, std::vector<Texture> textures, MeshResidency residency = Mesh::defaultResidency);
+		Mesh loadObj(const std::string &filename, MeshResidency residency = Mesh::defaultResidency);
 };
 
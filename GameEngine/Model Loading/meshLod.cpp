@@ -0,0 +1,159 @@
+#include "meshLod.h"
+#include <unordered_map>
+#include <cmath>
+
+//a level has to drop at least this share of the previous level's triangles
+#define MESH_LOD_MIN_REDUCTION 0.25f
+
+struct Cluster
+{
+	glm::vec3 pos;
+	glm::vec3 normals;
+	glm::vec2 textureCoords; // of the first vertex, averaging would smear across seams
+	unsigned int count;
+};
+
+MeshLod::MeshLod() : levelCount(1)
+{
+	for (int i = 0; i < MESH_LOD_LEVELS; i++)
+	{
+		errors[i] = 0.0f;
+		triangles[i] = 0;
+	}
+}
+
+float MeshLod::simplify(const std::vector<Vertex>& vertices, const std::vector<int>& indices, int grid,
+	std::vector<Vertex>& simplifiedVertices, std::vector<int>& simplifiedIndices)
+{
+	simplifiedVertices.clear();
+	simplifiedIndices.clear();
+	if (vertices.empty())
+		return 0.0f;
+
+	glm::vec3 low = vertices[0].pos, high = vertices[0].pos;
+	for (unsigned int v = 1; v < vertices.size(); v++)
+	{
+		low = glm::min(low, vertices[v].pos);
+		high = glm::max(high, vertices[v].pos);
+	}
+	glm::vec3 size = high - low;
+	float cell = glm::max(size.x, glm::max(size.y, size.z)) / grid;
+	if (cell <= 0.0f)
+		return 0.0f;
+
+	std::unordered_map<uint64_t, unsigned int> cells;
+	std::vector<Cluster> clusters;
+	std::vector<unsigned int> remap(vertices.size());
+
+	for (unsigned int v = 0; v < vertices.size(); v++)
+	{
+		glm::vec3 scaled = (vertices[v].pos - low) / cell;
+		uint64_t key = (uint64_t)scaled.x | ((uint64_t)scaled.y << 21) | ((uint64_t)scaled.z << 42);
+
+		std::unordered_map<uint64_t, unsigned int>::iterator found = cells.find(key);
+		if (found == cells.end())
+		{
+			Cluster cluster;
+			cluster.pos = glm::vec3(0.0f);
+			cluster.normals = glm::vec3(0.0f);
+			cluster.textureCoords = vertices[v].textureCoords;
+			cluster.count = 0;
+			found = cells.insert(std::make_pair(key, (unsigned int)clusters.size())).first;
+			clusters.push_back(cluster);
+		}
+
+		Cluster& cluster = clusters[found->second];
+		cluster.pos += vertices[v].pos;
+		cluster.normals += vertices[v].normals;
+		cluster.count++;
+		remap[v] = found->second;
+	}
+
+	for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+		if (a == b || b == c || c == a)
+			continue;
+		simplifiedIndices.push_back(a);
+		simplifiedIndices.push_back(b);
+		simplifiedIndices.push_back(c);
+	}
+
+	simplifiedVertices.resize(clusters.size());
+	for (unsigned int i = 0; i < clusters.size(); i++)
+	{
+		simplifiedVertices[i].pos = clusters[i].pos / (float)clusters[i].count;
+		float length = glm::length(clusters[i].normals);
+		simplifiedVertices[i].normals = length > 0.0f ? clusters[i].normals / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		simplifiedVertices[i].textureCoords = clusters[i].textureCoords;
+	}
+
+	//a vertex moves at most across its cell
+	return cell * std::sqrt(3.0f);
+}
+
+void MeshLod::build(const Mesh& mesh)
+{
+	if (mesh.vertices.empty())
+	{
+		std::cout << "Mesh LOD source has no CPU vertices, load it with MESH_RESIDENCY_FULL" << std::endl;
+		return;
+	}
+	build(mesh.vertices, mesh.indices, mesh.textures);
+}
+
+void MeshLod::build(const std::vector<Vertex>& vertices, const std::vector<int>& indices, const std::vector<Texture>& textures)
+{
+	setSource(indices.size() / 3);
+
+	std::vector<Vertex> simplifiedVertices;
+	std::vector<int> simplifiedIndices;
+	for (int grid = MESH_LOD_FIRST_GRID; grid >= 1 && levelCount < MESH_LOD_LEVELS; grid /= 2)
+	{
+		float error = simplify(vertices, indices, grid, simplifiedVertices, simplifiedIndices);
+		unsigned int count = simplifiedIndices.size() / 3;
+		if (count == 0)
+			break;
+		if (count > triangles[levelCount - 1] * (1.0f - MESH_LOD_MIN_REDUCTION))
+			continue;
+		addLevel(std::move(simplifiedVertices), std::move(simplifiedIndices), textures, error);
+	}
+}
+
+void MeshLod::setSource(unsigned int triangles)
+{
+	levels.clear();
+	levelCount = 1;
+	this->triangles[0] = triangles;
+}
+
+void MeshLod::addLevel(std::vector<Vertex> vertices, std::vector<int> indices, const std::vector<Texture>& textures, float error)
+{
+	if (levelCount >= MESH_LOD_LEVELS)
+		return;
+
+	errors[levelCount] = error;
+	triangles[levelCount] = indices.size() / 3;
+	levels.push_back(Mesh(std::move(vertices), std::move(indices), textures, MESH_RESIDENCY_NONE));
+	levelCount++;
+}
+
+int MeshLod::getLevelCount() const
+{
+	return levelCount;
+}
+
+const Mesh& MeshLod::getLevel(const Mesh& source, int level) const
+{
+	return level <= 0 ? source : levels[level - 1];
+}
+
+float MeshLod::getError(int level) const
+{
+	return errors[level];
+}
+
+unsigned int MeshLod::getTriangles(int level) const
+{
+	return triangles[level];
+}
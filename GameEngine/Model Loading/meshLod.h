@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include "mesh.h"
+
+//the source mesh and at most three simplified copies
+#define MESH_LOD_LEVELS 4
+//grid cells along the longest side for level 1, every next level halves it
+#define MESH_LOD_FIRST_GRID 32
+
+//Simplified versions of a mesh made at load time by vertex clustering: the vertices
+//are snapped to a grid, each occupied cell becomes one vertex and triangles that
+//collapse are dropped. Every level uses a grid twice as coarse as the one before.
+//Level 0 is the source itself and stays with its owner, only the copies live here.
+class MeshLod
+{
+public:
+	MeshLod();
+
+	//copies are GPU only and share the source's textures
+	void build(const std::vector<Vertex>& vertices, const std::vector<int>& indices, const std::vector<Texture>& textures);
+	//needs CPU vertices (MESH_RESIDENCY_FULL)
+	void build(const Mesh& mesh);
+
+	//for callers that simplify themselves (merged batches): the source's triangles,
+	//then each level with its error, coarser every time
+	void setSource(unsigned int triangles);
+	void addLevel(std::vector<Vertex> vertices, std::vector<int> indices, const std::vector<Texture>& textures, float error);
+
+	int getLevelCount() const;
+	const Mesh& getLevel(const Mesh& source, int level) const;
+	//how far a surface point of the level can be from the source, in model space
+	float getError(int level) const;
+	unsigned int getTriangles(int level) const;
+
+	//one clustering pass with grid cells along the longest side, returns the error
+	static float simplify(const std::vector<Vertex>& vertices, const std::vector<int>& indices, int grid,
+		std::vector<Vertex>& simplifiedVertices, std::vector<int>& simplifiedIndices);
+
+private:
+	std::vector<Mesh> levels; // level 1 first
+	float errors[MESH_LOD_LEVELS];
+	unsigned int triangles[MESH_LOD_LEVELS];
+	int levelCount;
+};
@@ -1,28 +1,30 @@
 #include "texture.h"
+#include "assets.h"
+#include "..\Graphics\glState.h"
 #include <iostream>
+#include <string>
 
 GLuint loadBMP(const char * imagepath) {
 
 	printf("Reading image %s\n", imagepath);
 
-	unsigned char header[54];
+	const unsigned char * header;
 	unsigned int dataPos;
 	unsigned int imageSize;
 	unsigned int width, height;
 
-	unsigned char * data;
-
-	FILE * file;
-	errno_t err = fopen_s(&file, imagepath, "rb");
-	if (err)
+	// Embedded copy or the file on disk, see Assets
+	std::string file;
+	if (!Assets::read(imagepath, file))
 	{
 		printf("%s could not be opened.", imagepath); getchar(); return 0;
 	}
 
-	if (fread(header, 1, 54, file) != 54) {
+	if (file.size() < 54) {
 		printf("Not a correct BMP file\n");
 		return 0;
 	}
+	header = (const unsigned char *)file.data();
 
 	// Parsing BMP file
 	if (header[0] != 'B' || header[1] != 'M') {
@@ -41,24 +43,22 @@ GLuint loadBMP(const char * imagepath) {
 	if (imageSize == 0)    imageSize = width*height * 3; 
 	if (dataPos == 0)      dataPos = 54; 
 
-										
-	data = new unsigned char[imageSize];
-
-	// Read data into buffer
-	fread(data, 1, imageSize, file);
+	if (dataPos > file.size() || imageSize > file.size() - dataPos) {
+		printf("Not a correct BMP file\n");
+		return 0;
+	}
 
-	fclose(file);
+	// Pixels are uploaded straight from the buffer
+	const unsigned char * data = header + dataPos;
 
 	// Create OpenGL texture
 	GLuint textureID;
 	glGenTextures(1, &textureID);
 
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLState::bindTexture(0, textureID);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
 
-	delete[] data;
-
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -3,19 +3,75 @@
 in vec2 textureCoord; 
 in vec3 norm;
 in vec3 fragPos;
+#ifdef VERTEX_LIGHTING
+in vec3 lighting;
+#endif
 
 out vec4 fragColor;
 
 uniform sampler2D texture1;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#ifndef VERTEX_LIGHTING
+//the sun's cascades, always on SHADOW_MAP_UNIT
+uniform sampler2DArrayShadow shadowMap;
+#endif
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 lightPos;
+	vec4 lightColor;
+	vec4 viewPos;
+	vec4 time;
+	vec4 fogColor;
+	mat4 shadowMatrices[3]; // SHADOW_CASCADES
+	vec4 shadowSplits;
+};
+
+#ifdef LOD_DITHER
+//screen-door crossfade between two LOD levels: the incoming one gets the fade
+//progress, the outgoing one its negation, together they cover every pixel once
+uniform float lodFade;
+
+//4x4 ordered dither thresholds
+const float bayer[16] = float[16](0.5f, 8.5f, 2.5f, 10.5f, 12.5f, 4.5f, 14.5f, 6.5f,
+	3.5f, 11.5f, 1.5f, 9.5f, 15.5f, 7.5f, 13.5f, 5.5f);
+#endif
+
+#ifndef VERTEX_LIGHTING
+//1 lit, 0 in the sun's shadow. The nearest cascade whose split covers the fragment decides,
+//past the last split (or with no splits, shadows off) everything is lit
+float sunShadow()
+{
+	float distance = length(viewPos.xyz - fragPos);
+	for (int i = 0; i < 3; i++)
+	{
+		if (distance < shadowSplits[i])
+		{
+			vec4 coord = shadowMatrices[i] * vec4(fragPos, 1.0f);
+			return texture(shadowMap, vec4(coord.xy, float(i), coord.z - 0.0002f));
+		}
+	}
+	return 1.0f;
+}
+#endif
 
 void main()
 {
+#ifdef LOD_DITHER
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+	float threshold = bayer[pixel.y * 4 + pixel.x] / 16.0f;
+	if (lodFade > 0.0f ? threshold > lodFade : threshold <= -lodFade)
+		discard;
+#endif
+
+#ifdef VERTEX_LIGHTING
+	vec3 result = lighting;
+#else
 	//Ambient light
 	float ambientStrength = 0.5;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
 //	vec3 objectColor = vec3(1.0f, 0.5f, 0.31f);
 
 	//vec3 result = ambient * objectColor;
@@ -23,19 +79,39 @@ void main()
 
 	//Diffuse light
 	vec3 normal = normalize(norm);
-	vec3 lightDir = normalize(lightPos - fragPos); 
+	vec3 lightDir = normalize(lightPos.xyz - fragPos); 
 
 	float diff = max(dot(normal, lightDir), 0.0f);
-	vec3 diffuse = diff * lightColor;
+	vec3 diffuse = diff * lightColor.rgb;
+
+	//the ambient part stays, the sun's is shadowed
+	float shadow = sunShadow();
+	vec3 result = ambient + diffuse * shadow;
 
+#ifndef NO_SPECULAR
 	//Specular light
 	float specularStrength = 0.7;
-	vec3 viewDir = normalize(viewPos - fragPos);
+	vec3 viewDir = normalize(viewPos.xyz - fragPos);
 	vec3 reflectDir = reflect(-lightDir, normal); 
 	float spec = pow(max(dot(viewDir, reflectDir), 0.0), 64);
-	vec3 specular = specularStrength * spec * lightColor; 
+	vec3 specular = specularStrength * spec * lightColor.rgb; 
+
+	result += specular * shadow;
+#endif
+#endif
+
+	vec4 texColor = texture(texture1, textureCoord);
+#ifdef ALPHA_TEST
+	if (texColor.a < 0.5f)
+		discard;
+#endif
 
-	vec3 result = ambient + diffuse + specular;
 	fragColor = vec4(result, 1.0f);
-	fragColor = fragColor * texture(texture1, textureCoord);
+	fragColor = fragColor * texColor;
+
+#ifdef FOG
+	//fogColor.a is the density
+	float fogAmount = 1.0f - exp(-fogColor.a * length(viewPos.xyz - fragPos));
+	fragColor.rgb = mix(fragColor.rgb, fogColor.rgb, fogAmount);
+#endif
 }
\ No newline at end of file
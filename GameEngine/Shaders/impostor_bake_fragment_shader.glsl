@@ -0,0 +1,16 @@
+#version 400
+
+in vec2 textureCoord;
+in vec3 norm;
+
+layout (location = 0) out vec4 albedo;      // color premultiplied by coverage
+layout (location = 1) out vec4 normalDepth; // object space normal, depth in alpha
+
+uniform sampler2D texture1;
+
+void main()
+{
+	albedo = vec4(texture(texture1, textureCoord).rgb, 1.0f);
+	//linear under the orthographic projection, 0.5 is the plane through the center
+	normalDepth = vec4(normalize(norm) * 0.5f + 0.5f, gl_FragCoord.z);
+}
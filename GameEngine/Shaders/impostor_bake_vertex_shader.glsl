@@ -0,0 +1,32 @@
+#version 400
+
+//packed arena vertex, see Graphics/vertexFormat.h
+layout (location = 0) in vec3 pos;     // snorm16, dequantized with meshDequant
+layout (location = 1) in vec2 normals; // snorm16 octahedral
+layout (location = 2) in vec2 texCoord; // half float
+
+out vec2 textureCoord;
+out vec3 norm;
+
+uniform vec4 meshDequant;
+//places the part relative to the object origin, no FrameData here: baking runs before the first frame
+uniform mat4 partModel;
+//orthographic view of one atlas frame
+uniform mat4 frameViewProj;
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	textureCoord = texCoord;
+	//parts only translate and scale uniformly
+	norm = mat3(partModel) * decodeOctahedral(normals);
+	gl_Position = frameViewProj * partModel * vec4(pos * meshDequant.w + meshDequant.xyz, 1.0f);
+}
@@ -0,0 +1,61 @@
+#version 400
+
+flat in vec2 frameTiles[4];
+flat in vec4 frameWeights;
+in vec3 frameLocal[4];
+in vec3 frameRay[4];
+flat in vec3 lightLocal;
+flat in float radius;
+
+out vec4 fragColor;
+
+uniform sampler2D texture_diffuse1; // color premultiplied by coverage
+uniform sampler2D texture_normal1;  // object space normal, depth in alpha
+uniform float impostorFrames;
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 lightPos;
+	vec4 lightColor;
+	vec4 viewPos;
+	vec4 time;
+	vec4 fogColor;
+};
+
+//one parallax step: from where the ray crosses the view's center plane to the depth
+//stored there. Depth 0.5 is the center plane, the view spans 2 radii either way
+vec2 frameUv(vec2 tile, vec3 local, vec3 ray, float edge)
+{
+	vec3 onPlane = local - ray * (local.z / ray.z);
+	vec2 uv = clamp(onPlane.xy / (2.0f * radius) + 0.5f, edge, 1.0f - edge);
+	float depth = texture(texture_normal1, tile + uv / impostorFrames).a;
+
+	vec3 hit = onPlane + ray * ((depth - 0.5f) * 4.0f * radius / ray.z);
+	return tile + clamp(hit.xy / (2.0f * radius) + 0.5f, edge, 1.0f - edge) / impostorFrames;
+}
+
+void main()
+{
+	//half a texel, so filtering never reaches into the neighbouring view
+	float edge = impostorFrames * 0.5f / float(textureSize(texture_normal1, 0).x);
+
+	vec4 albedo = vec4(0.0f);
+	vec3 normal = vec3(0.0f);
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 uv = frameUv(frameTiles[i], frameLocal[i], frameRay[i], edge);
+		albedo += frameWeights[i] * texture(texture_diffuse1, uv);
+		normal += frameWeights[i] * (texture(texture_normal1, uv).xyz * 2.0f - 1.0f);
+	}
+
+	//coverage is averaged by the view blend and the mipmaps
+	if (albedo.a < 0.5f)
+		discard;
+
+	//ambient + diffuse like the distant lighting levels of the lit shader
+	float diff = max(dot(normalize(normal), normalize(lightLocal)), 0.0f);
+	fragColor = vec4((0.5f + diff) * lightColor.rgb * (albedo.rgb / albedo.a), 1.0f);
+}
@@ -0,0 +1,93 @@
+#version 400
+
+//corner of the unit quad, packed in the arena like any mesh
+layout (location = 0) in vec3 pos; // snorm16, dequantized with meshDequant
+//places the object origin: translation, rotation and uniform scale only
+layout (location = 3) in mat4 instanceModel;
+
+//the four atlas views around the eye direction: tile origin and bilinear weight,
+//the quad point and the view ray in each view's (right, up, forward) frame
+flat out vec2 frameTiles[4];
+flat out vec4 frameWeights;
+out vec3 frameLocal[4];
+out vec3 frameRay[4];
+flat out vec3 lightLocal;
+flat out float radius;
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 lightPos;
+	vec4 lightColor;
+	vec4 viewPos;
+	vec4 time;
+	vec4 fogColor;
+};
+
+uniform vec4 meshDequant;
+uniform vec4 impostorBounds;  // bounding sphere, object space center and radius
+uniform float impostorFrames; // views per side of the atlas
+
+//upper hemisphere to [-1, 1]^2, the same mapping as the bake in Graphics/impostor.cpp
+vec2 encodeHemiOctahedral(vec3 d)
+{
+	d.y = max(d.y, 0.0f);
+	d /= max(abs(d.x) + d.y + abs(d.z), 0.00001f);
+	return vec2(d.x + d.z, d.x - d.z);
+}
+
+vec3 decodeHemiOctahedral(vec2 e)
+{
+	vec2 t = vec2(e.x + e.y, e.x - e.y) * 0.5f;
+	return normalize(vec3(t.x, 1.0f - abs(t.x) - abs(t.y), t.y));
+}
+
+//basis of a view looking at the center from direction d, as glm::lookAt builds it
+void viewBasis(vec3 d, out vec3 right, out vec3 up, out vec3 forward)
+{
+	forward = -d;
+	vec3 worldUp = abs(d.y) > 0.999f ? vec3(0.0f, 0.0f, -1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	right = normalize(cross(forward, worldUp));
+	up = cross(right, forward);
+}
+
+void main()
+{
+	mat3 rotation = mat3(instanceModel);
+	float scale = length(rotation[0]);
+	vec3 center = vec3(instanceModel * vec4(impostorBounds.xyz, 1.0f));
+	radius = impostorBounds.w * scale;
+
+	//camera facing quad through the center
+	vec3 toEye = viewPos.xyz - center;
+	vec3 right, up, forward;
+	viewBasis(normalize(toEye), right, up, forward);
+	vec3 corner = pos * meshDequant.w + meshDequant.xyz;
+	vec3 world = center + (corner.x * right + corner.y * up) * radius;
+	gl_Position = viewProj * vec4(world, 1.0f);
+
+	//the atlas was baked in object orientation, distances stay in world units
+	mat3 toObject = transpose(rotation) / scale;
+	vec2 grid = (encodeHemiOctahedral(normalize(toObject * toEye)) * 0.5f + 0.5f) * (impostorFrames - 1.0f);
+	vec2 base = min(floor(grid), impostorFrames - 2.0f);
+	vec2 f = grid - base;
+	frameWeights = vec4((1.0f - f.x) * (1.0f - f.y), f.x * (1.0f - f.y), (1.0f - f.x) * f.y, f.x * f.y);
+
+	//both are linear over the quad, so they interpolate exactly
+	vec3 point = toObject * (world - center);
+	vec3 ray = toObject * (world - viewPos.xyz);
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 cell = base + vec2(i & 1, i >> 1);
+		vec3 frameRight, frameUp, frameForward;
+		viewBasis(decodeHemiOctahedral(cell / (impostorFrames - 1.0f) * 2.0f - 1.0f), frameRight, frameUp, frameForward);
+
+		frameTiles[i] = cell / impostorFrames;
+		frameLocal[i] = vec3(dot(point, frameRight), dot(point, frameUp), dot(point, frameForward));
+		frameRay[i] = vec3(dot(ray, frameRight), dot(ray, frameUp), dot(ray, frameForward));
+	}
+
+	lightLocal = toObject * (lightPos.xyz - center);
+}
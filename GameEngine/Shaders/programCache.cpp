@@ -0,0 +1,165 @@
+#include "programCache.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+std::unordered_map<uint64_t, unsigned int> ProgramCache::programs;
+std::string ProgramCache::directory = "ShaderCache";
+
+//header written in front of every cached binary
+struct ProgramBinaryHeader
+{
+	uint32_t magic;
+	uint32_t format;
+	uint32_t length;
+	uint32_t padding;
+	uint64_t key;
+};
+
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x43535244; // "DRSC"
+
+//FNV-1a 64
+uint64_t ProgramCache::hash(const char* data, size_t size, uint64_t seed)
+{
+	uint64_t h = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= (unsigned char)data[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+uint64_t ProgramCache::hash(const std::string& text, uint64_t seed)
+{
+	//include the terminator so "ab"+"c" and "a"+"bc" hash differently
+	return hash(text.c_str(), text.size() + 1, seed);
+}
+
+uint64_t ProgramCache::makeKey(uint64_t vertexHash, uint64_t fragmentHash, const std::string& defines)
+{
+	static std::string driver;
+	if (driver.empty())
+	{
+		const char* vendor = (const char*)glGetString(GL_VENDOR);
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		const char* version = (const char*)glGetString(GL_VERSION);
+		driver = std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+	}
+
+	uint64_t key = hash((const char*)&vertexHash, sizeof(vertexHash));
+	key = hash((const char*)&fragmentHash, sizeof(fragmentHash), key);
+	key = hash(defines, key);
+	return hash(driver, key);
+}
+
+unsigned int ProgramCache::find(uint64_t key)
+{
+	std::unordered_map<uint64_t, unsigned int>::iterator it = programs.find(key);
+	return it != programs.end() ? it->second : 0;
+}
+
+void ProgramCache::add(uint64_t key, unsigned int program)
+{
+	programs[key] = program;
+}
+
+bool ProgramCache::binariesSupported()
+{
+	static int formats = -1;
+	if (formats < 0)
+	{
+		formats = 0;
+		if (glGetProgramBinary != NULL && glProgramBinary != NULL)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	return formats > 0;
+}
+
+void ProgramCache::setDirectory(const std::string& directory)
+{
+	ProgramCache::directory = directory;
+}
+
+std::string ProgramCache::binaryPath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+unsigned int ProgramCache::loadBinary(uint64_t key)
+{
+	if (!binariesSupported())
+		return 0;
+
+	std::ifstream file(binaryPath(key).c_str(), std::ios::in | std::ios::binary);
+	if (!file.good())
+		return 0;
+
+	ProgramBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_BINARY_MAGIC || header.key != key)
+		return 0;
+
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), header.length))
+		return 0;
+
+	unsigned int program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), header.length);
+
+	//the driver may reject binaries from an older version, the caller then compiles from source
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		std::cout << "Cached shader binary rejected, recompiling" << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void ProgramCache::storeBinary(uint64_t key, unsigned int program)
+{
+	if (!binariesSupported())
+		return;
+
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramBinaryHeader header;
+	header.magic = PROGRAM_BINARY_MAGIC;
+	header.padding = 0;
+	header.key = key;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(program, length, NULL, &format, binary.data());
+	header.format = format;
+	header.length = length;
+
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	std::ofstream file(binaryPath(key).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		std::cout << "Could not write shader cache " << binaryPath(key) << std::endl;
+		return;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glew.h>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+//Keeps linked programs around so they are only built once:
+// - programs built from identical sources/defines share one GL program per run
+// - linked binaries are saved with glGetProgramBinary and reloaded on the next launch
+class ProgramCache
+{
+public:
+	static uint64_t hash(const char* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+	static uint64_t hash(const std::string& text, uint64_t seed = 14695981039346656037ULL);
+
+	//key covers the source hashes (see Assets::read), the defines and the driver (vendor/renderer/version)
+	static uint64_t makeKey(uint64_t vertexHash, uint64_t fragmentHash, const std::string& defines);
+
+	//program already linked in this run, 0 if none
+	static unsigned int find(uint64_t key);
+	static void add(uint64_t key, unsigned int program);
+
+	//program restored from the disk cache, 0 if missing or rejected by the driver
+	static unsigned int loadBinary(uint64_t key);
+	static void storeBinary(uint64_t key, unsigned int program);
+
+	static bool binariesSupported();
+	static void setDirectory(const std::string& directory);
+
+private:
+	static std::string binaryPath(uint64_t key);
+
+	static std::unordered_map<uint64_t, unsigned int> programs;
+	static std::string directory;
+};
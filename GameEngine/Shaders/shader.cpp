@@ -1,46 +1,272 @@
 #include "shader.h"
+#include "programCache.h"
+#include "..\Graphics\uniformBuffer.h"
+#include "..\Model Loading\assets.h"
 #include <iostream>
 #include <vector>
+#include <string.h>
 
 using namespace std;
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* defines)
 {
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vertexShaderFile;
-	std::ifstream fragmentShaderFile;
+	uint64_t vertexHash = 0, fragmentHash = 0;
+	std::string vertexCode = injectDefines(readFile(vertexPath, &vertexHash), defines);
+	std::string fragmentCode = injectDefines(readFile(fragmentPath, &fragmentHash), defines);
 
-	try
+	//identical programs (e.g. the meteor shaders) share one GL program
+	uint64_t key = ProgramCache::makeKey(vertexHash, fragmentHash, defines);
+	id = ProgramCache::find(key);
+	if (id == 0)
 	{
-		vertexShaderFile.open(vertexPath);
-		fragmentShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
+		id = ProgramCache::loadBinary(key);
+		if (id == 0)
+		{
+			id = compile(vertexCode, fragmentCode);
+			ProgramCache::storeBinary(key, id);
+		}
 
-		vShaderStream << vertexShaderFile.rdbuf();
-		fShaderStream << fragmentShaderFile.rdbuf();
+		ProgramCache::add(key, id);
+	}
+
+	reflect();
+}
 
-		vertexShaderFile.close();
-		fragmentShaderFile.close();
+Shader::Shader(unsigned int program)
+{
+	id = program;
+	reflect();
+}
 
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+//FNV-1a 32, also used by callers to precompute sampler names
+uint32_t Shader::hashName(const char* name)
+{
+	uint32_t h = 2166136261u;
+	for (; *name; name++)
+	{
+		h ^= (unsigned char)*name;
+		h *= 16777619u;
 	}
-	catch (std::ifstream::failure e)
+	return h;
+}
+
+static bool isSampler(GLenum type)
+{
+	switch (type)
+	{
+	case GL_SAMPLER_1D:
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_3D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_SAMPLER_BUFFER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//builds the uniform table and gives every sampler a fixed texture unit
+void Shader::reflect()
+{
+	int count = 0, maxLength = 0;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	unsigned int capacity = 8;
+	while (capacity < (unsigned int)count * 2)
+		capacity *= 2;
+
+	UniformSlot empty = { 0, -1, 0, -1, false, std::string() };
+	uniforms.assign(capacity, empty);
+
+	std::vector<char> name(maxLength + 1);
+	int nextUnit = 0;
+
+	//uniform blocks go to the binding points shared by every program
+	unsigned int frameBlock = glGetUniformBlockIndex(id, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(id, frameBlock, FRAME_BLOCK_BINDING);
+
+	unsigned int objectBlock = glGetUniformBlockIndex(id, "ObjectData");
+	if (objectBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(id, objectBlock, OBJECT_BLOCK_BINDING);
+
+	//only the INDIRECT variants have it, and only drivers with storage buffers
+	if (glShaderStorageBlockBinding != NULL)
+	{
+		unsigned int recordBlock = glGetProgramResourceIndex(id, GL_SHADER_STORAGE_BLOCK, "ObjectRecords");
+		if (recordBlock != GL_INVALID_INDEX)
+			glShaderStorageBlockBinding(id, recordBlock, OBJECT_STORAGE_BINDING);
+
+		unsigned int dynamicBlock = glGetProgramResourceIndex(id, GL_SHADER_STORAGE_BLOCK, "DynamicRecords");
+		if (dynamicBlock != GL_INVALID_INDEX)
+			glShaderStorageBlockBinding(id, dynamicBlock, DYNAMIC_STORAGE_BINDING);
+	}
+
+	//the name may belong to a deleted program, its shadowed values are stale
+	GLState::forgetProgram(id);
+	GLState::useProgram(id);
+	for (int i = 0; i < count; i++)
+	{
+		int size;
+		GLenum type;
+		glGetActiveUniform(id, i, maxLength + 1, NULL, &size, &type, &name[0]);
+
+		//members of uniform blocks have no location
+		int location = glGetUniformLocation(id, &name[0]);
+		if (location < 0)
+			continue;
+
+		//arrays are reported as "name[0]", store them as "name"
+		char* bracket = strchr(&name[0], '[');
+		if (bracket)
+			*bracket = '\0';
+
+		UniformSlot slot = { hashName(&name[0]), location, type, -1, false, std::string(&name[0]) };
+		if (isSampler(type) && strcmp(&name[0], "shadowMap") == 0)
+		{
+			slot.unit = SHADOW_MAP_UNIT;
+			glUniform1i(location, SHADOW_MAP_UNIT);
+		}
+		else if (isSampler(type))
+		{
+			slot.unit = nextUnit;
+			for (int j = 0; j < size; j++)
+				glUniform1i(location + j, nextUnit++);
+		}
+
+		unsigned int index = slot.hash & (capacity - 1);
+		while (uniforms[index].location >= 0)
+		{
+			UniformSlot& other = uniforms[index];
+			if (other.hash == slot.hash)
+			{
+				std::cout << "Uniforms " << other.name << " and " << slot.name << " have the same name hash, "
+					<< "only lookups by name find them" << std::endl;
+				other.collided = true;
+				slot.collided = true;
+			}
+			index = (index + 1) & (capacity - 1);
+		}
+		uniforms[index] = slot;
+	}
+}
+
+const Shader::UniformSlot* Shader::findSlot(uint32_t hash, const char* name) const
+{
+	unsigned int mask = (unsigned int)uniforms.size() - 1;
+	for (unsigned int index = hash & mask; uniforms[index].location >= 0; index = (index + 1) & mask)
+	{
+		const UniformSlot& slot = uniforms[index];
+		if (slot.hash != hash)
+			continue;
+		if (name != NULL)
+		{
+			if (slot.name == name)
+				return &slot;
+		}
+		else
+			return slot.collided ? NULL : &slot;
+	}
+	return NULL;
+}
+
+Uniform Shader::getUniform(const char* name) const
+{
+	const UniformSlot* slot = findSlot(hashName(name), name);
+	return slot ? Uniform(id, slot->location, slot->type) : Uniform();
+}
+
+Uniform Shader::getUniform(uint32_t nameHash) const
+{
+	const UniformSlot* slot = findSlot(nameHash, NULL);
+	return slot ? Uniform(id, slot->location, slot->type) : Uniform();
+}
+
+int Shader::getSamplerUnit(uint32_t nameHash) const
+{
+	const UniformSlot* slot = findSlot(nameHash, NULL);
+	return slot ? slot->unit : -1;
+}
+
+std::string Shader::readFile(const char* path, uint64_t* hash)
+{
+	std::string code;
+	if (!Assets::read(path, code, hash))
+		std::cout << "Error reading shader " << path << "!" << std::endl;
+
+	return code;
+}
+
+std::string Shader::injectDefines(const std::string& code, const std::string& defines)
+{
+	if (defines.empty())
+		return code;
+
+	//#version has to stay the first statement
+	size_t pos = 0;
+	if (code.compare(0, 8, "#version") == 0)
 	{
-		std::cout << "Error reading shader!" << std::endl;
+		pos = code.find('\n');
+		pos = (pos == std::string::npos) ? code.size() : pos + 1;
 	}
+
+	return code.substr(0, pos) + defines + code.substr(pos);
+}
+
+unsigned int Shader::compile(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	return finishBuild(startBuild(vertexCode, fragmentCode));
+}
+
+//issues compile and link without asking for the result, so drivers with
+//parallel compilation (or a worker context) can build in the background
+ShaderBuild Shader::startBuild(const std::string& vertexCode, const std::string& fragmentCode)
+{
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	//compile shaders
-	unsigned int vertex, fragment;
-	int success;
+	ShaderBuild build;
 
 	// vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
+	build.vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(build.vertex, 1, &vShaderCode, NULL);
+	glCompileShader(build.vertex);
+
+	// fragment Shader
+	build.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragment, 1, &fShaderCode, NULL);
+	glCompileShader(build.fragment);
+
+	// shader Program
+	build.program = glCreateProgram();
+	glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(build.program, build.vertex);
+	glAttachShader(build.program, build.fragment);
+	glLinkProgram(build.program);
+
+	return build;
+}
+
+//never blocks when GL_KHR_parallel_shader_compile is available
+bool Shader::isBuildDone(const ShaderBuild& build)
+{
+	if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+		return true;
+
+	int done = GL_FALSE;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+unsigned int Shader::finishBuild(const ShaderBuild& build)
+{
+	unsigned int vertex = build.vertex;
+	unsigned int fragment = build.fragment;
+	int success;
 
 	// compile errors 
 	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
@@ -49,11 +275,6 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 		std::cout << "Error compiling vertex shader! " << std::endl;
 	}
 
-	// fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-
 	// compile errors
 	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
 	if (!success)
@@ -82,14 +303,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 		printf("%s\n", &FragmentShaderErrorMessage[0]);
 	}
 
-	// shader Program
-	id = glCreateProgram();
-	glAttachShader(id, vertex);
-	glAttachShader(id, fragment);
-	glLinkProgram(id);
-
 	// linking errors
-	glGetProgramiv(id, GL_LINK_STATUS, &success);
+	glGetProgramiv(build.program, GL_LINK_STATUS, &success);
 	if (!success)
 	{
 		std::cout << "Error linking shader!" << std::endl;
@@ -97,11 +312,20 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
  
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+
+	return build.program;
+}
+
+bool Shader::isLinked(unsigned int program)
+{
+	int success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success == GL_TRUE;
 }
 
 void Shader::use()
 {
-	glUseProgram(id);
+	GLState::useProgram(id);
 }
 
 int Shader::getId()
@@ -1,20 +1,95 @@
 #pragma once
 
 #include <glew.h>
+#include <glm.hpp>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <stdint.h>
+#include "..\Graphics\glState.h"
+
+//typed handle to a uniform of the currently bound program, resolved once.
+//Values already set on the program are filtered by GLState
+class Uniform
+{
+public:
+	unsigned int program;
+	int location;
+	unsigned int type;
+
+	Uniform() : program(0), location(-1), type(0) {}
+	Uniform(unsigned int program, int location, unsigned int type) : program(program), location(location), type(type) {}
+
+	bool isValid() const { return location >= 0; }
+
+	void set(const glm::mat4& value) const { if (changed(&value[0][0], sizeof(value))) glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+	void set(const glm::mat3& value) const { if (changed(&value[0][0], sizeof(value))) glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+	void set(const glm::vec4& value) const { if (changed(&value.x, sizeof(value))) glUniform4f(location, value.x, value.y, value.z, value.w); }
+	void set(const glm::vec3& value) const { if (changed(&value.x, sizeof(value))) glUniform3f(location, value.x, value.y, value.z); }
+	void set(float value) const { if (changed(&value, sizeof(value))) glUniform1f(location, value); }
+	void set(int value) const { if (changed(&value, sizeof(value))) glUniform1i(location, value); }
+
+private:
+	bool changed(const void* value, unsigned int size) const { return GLState::uniformChanged(program, location, value, size); }
+};
+
+//program whose compile/link was issued but not checked yet
+struct ShaderBuild
+{
+	unsigned int program;
+	unsigned int vertex;
+	unsigned int fragment;
+};
 
 class Shader
 {
 public:
-	Shader(const char* vertexPath, const char* fragmentPath);
+	//defines are inserted right after the #version line, e.g. "#define NO_SPECULAR\n"
+	Shader(const char* vertexPath, const char* fragmentPath, const char* defines = "");
+	//wraps a program that is already linked
+	explicit Shader(unsigned int program);
 	~Shader();
 	void use();
 	int getId();
 
+	//lookups go through the table built at link time, no GL queries. Lookups by hash
+	//find nothing when two uniforms of the program share it, reflect() reports those
+	Uniform getUniform(const char* name) const;
+	Uniform getUniform(uint32_t nameHash) const;
+	int getSamplerUnit(uint32_t nameHash) const;
+
+	static uint32_t hashName(const char* name);
+
+	//embedded copy unless Assets has the disk override on, hash identifies the source
+	static std::string readFile(const char* path, uint64_t* hash = NULL);
+	static std::string injectDefines(const std::string& code, const std::string& defines);
+
+	//building in steps, used by ShaderLibrary for background builds
+	static ShaderBuild startBuild(const std::string& vertexCode, const std::string& fragmentCode);
+	static bool isBuildDone(const ShaderBuild& build);
+	static unsigned int finishBuild(const ShaderBuild& build);
+	static bool isLinked(unsigned int program);
+
 private:
+	//active uniform, stored by name hash (open addressing, power of two size)
+	struct UniformSlot
+	{
+		uint32_t hash;
+		int location;
+		unsigned int type;
+		int unit;
+		bool collided; // another uniform has the same hash
+		std::string name;
+	};
+
 	unsigned int id;
-};
+	std::vector<UniformSlot> uniforms;
 
+	void reflect();
+	//name NULL matches by hash alone
+	const UniformSlot* findSlot(uint32_t hash, const char* name) const;
+
+	static unsigned int compile(const std::string& vertexCode, const std::string& fragmentCode);
+};
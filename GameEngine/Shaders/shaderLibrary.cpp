@@ -0,0 +1,253 @@
+#include "shaderLibrary.h"
+#include "programCache.h"
+
+static const char* featureDefines[SHADER_FEATURE_COUNT] =
+{
+	"#define NO_SPECULAR\n",
+	"#define INSTANCED\n",
+	"#define ALPHA_TEST\n",
+	"#define FOG\n",
+	"#define VERTEX_LIGHTING\n",
+	"#define INDIRECT\n",
+	"#define LOD_DITHER\n"
+};
+
+ShaderLibrary::ShaderLibrary(const char* vertexPath, const char* fragmentPath)
+	: workerContext(NULL), stopWorker(false)
+{
+	vertexSource = Shader::readFile(vertexPath, &vertexHash);
+	fragmentSource = Shader::readFile(fragmentPath, &fragmentHash);
+
+	for (int i = 0; i < SHADER_VARIANT_COUNT; i++)
+	{
+		variants[i].shader = NULL;
+		variants[i].state = VARIANT_UNUSED;
+		variants[i].key = 0;
+	}
+
+	//let the driver compile on its own threads
+	parallelCompile = false;
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+
+	//the base variant is the last resort fallback, it has to exist from the start
+	request(0, true);
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(workerMutex);
+			stopWorker = true;
+		}
+		workerWake.notify_one();
+		worker.join();
+	}
+
+	if (workerContext)
+		glfwDestroyWindow(workerContext);
+
+	for (int i = 0; i < SHADER_VARIANT_COUNT; i++)
+		delete variants[i].shader;
+}
+
+void ShaderLibrary::setWorkerContext(GLFWwindow* context)
+{
+	if (parallelCompile || context == NULL)
+	{
+		if (context)
+			glfwDestroyWindow(context);
+		return;
+	}
+
+	workerContext = context;
+	worker = std::thread(&ShaderLibrary::workerLoop, this);
+}
+
+std::string ShaderLibrary::makeDefines(unsigned int features)
+{
+	std::string defines;
+	for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+	{
+		if (features & (1 << i))
+			defines += featureDefines[i];
+	}
+	return defines;
+}
+
+bool ShaderLibrary::isReady(unsigned int features) const
+{
+	return variants[features].state == VARIANT_READY;
+}
+
+Shader& ShaderLibrary::get(unsigned int features)
+{
+	Variant& variant = variants[features];
+	if (variant.state == VARIANT_READY)
+		return *variant.shader;
+
+	if (variant.state == VARIANT_UNUSED)
+		request(features, false);
+
+	if (variant.state == VARIANT_READY)
+		return *variant.shader;
+
+	//closest variant with the same vertex inputs. When that is the variant itself
+	//nothing else can draw it, so it is built right away
+	unsigned int fallback = features & SHADER_INTERFACE_FEATURES;
+	if (variants[fallback].state != VARIANT_READY && variants[fallback].state != VARIANT_FAILED)
+		request(fallback, true);
+
+	if (variants[fallback].state == VARIANT_READY)
+		return *variants[fallback].shader;
+
+	return *variants[0].shader;
+}
+
+void ShaderLibrary::request(unsigned int features, bool wait)
+{
+	Variant& variant = variants[features];
+	std::string defines = makeDefines(features);
+	std::string vertexCode = Shader::injectDefines(vertexSource, defines);
+	std::string fragmentCode = Shader::injectDefines(fragmentSource, defines);
+
+	if (variant.state == VARIANT_UNUSED)
+	{
+		variant.key = ProgramCache::makeKey(vertexHash, fragmentHash, defines);
+
+		unsigned int program = ProgramCache::find(variant.key);
+		if (program == 0)
+			program = ProgramCache::loadBinary(variant.key);
+
+		if (program != 0)
+		{
+			finish(features, program, false);
+			return;
+		}
+	}
+
+	if (wait)
+	{
+		//a build already running in the driver is simply waited for,
+		//one queued on the worker is built again here and the late result dropped
+		if (variant.state == VARIANT_BUILDING && parallelCompile)
+			finish(features, Shader::finishBuild(variant.build), true);
+		else
+			finish(features, Shader::finishBuild(Shader::startBuild(vertexCode, fragmentCode)), true);
+		return;
+	}
+
+	if (parallelCompile)
+	{
+		variant.build = Shader::startBuild(vertexCode, fragmentCode);
+		variant.state = VARIANT_BUILDING;
+	}
+	else if (workerContext)
+	{
+		WorkerJob job;
+		job.features = features;
+		job.vertexCode = vertexCode;
+		job.fragmentCode = fragmentCode;
+		{
+			std::lock_guard<std::mutex> lock(workerMutex);
+			jobs.push_back(job);
+		}
+		workerWake.notify_one();
+		variant.state = VARIANT_BUILDING;
+	}
+	else
+	{
+		finish(features, Shader::finishBuild(Shader::startBuild(vertexCode, fragmentCode)), true);
+	}
+}
+
+void ShaderLibrary::finish(unsigned int features, unsigned int program, bool compiled)
+{
+	Variant& variant = variants[features];
+
+	if (!Shader::isLinked(program))
+	{
+		std::cout << "Shader variant " << features << " failed, keeping the fallback" << std::endl;
+		glDeleteProgram(program);
+		variant.state = VARIANT_FAILED;
+		return;
+	}
+
+	if (compiled)
+		ProgramCache::storeBinary(variant.key, program);
+	ProgramCache::add(variant.key, program);
+
+	variant.shader = new Shader(program);
+	variant.state = VARIANT_READY;
+}
+
+void ShaderLibrary::update()
+{
+	if (parallelCompile)
+	{
+		for (unsigned int i = 0; i < SHADER_VARIANT_COUNT; i++)
+		{
+			if (variants[i].state == VARIANT_BUILDING && Shader::isBuildDone(variants[i].build))
+				finish(i, Shader::finishBuild(variants[i].build), true);
+		}
+		return;
+	}
+
+	std::vector<WorkerResult> done;
+	{
+		std::lock_guard<std::mutex> lock(workerMutex);
+		done.swap(results);
+	}
+
+	for (unsigned int i = 0; i < done.size(); i++)
+	{
+		if (variants[done[i].features].state == VARIANT_BUILDING)
+			finish(done[i].features, done[i].program, true);
+		else
+			glDeleteProgram(done[i].program);
+	}
+}
+
+//compiles on a hidden context that shares objects with the main one
+void ShaderLibrary::workerLoop()
+{
+	glfwMakeContextCurrent(workerContext);
+
+	while (true)
+	{
+		WorkerJob job;
+		{
+			std::unique_lock<std::mutex> lock(workerMutex);
+			while (jobs.empty() && !stopWorker)
+				workerWake.wait(lock);
+
+			if (stopWorker)
+				break;
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		WorkerResult result;
+		result.features = job.features;
+		result.program = Shader::finishBuild(Shader::startBuild(job.vertexCode, job.fragmentCode));
+
+		//the program has to be complete before the main context uses it
+		glFinish();
+
+		std::lock_guard<std::mutex> lock(workerMutex);
+		results.push_back(result);
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
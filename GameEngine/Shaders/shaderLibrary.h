@@ -0,0 +1,96 @@
+#pragma once
+
+#include "shader.h"
+#include <glfw3.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+//feature bits, each one adds a #define to both stages
+enum ShaderFeature
+{
+	SHADER_NO_SPECULAR = 1 << 0,
+	SHADER_INSTANCED = 1 << 1,
+	SHADER_ALPHA_TEST = 1 << 2,
+	SHADER_FOG = 1 << 3,
+	SHADER_VERTEX_LIGHTING = 1 << 4,
+	SHADER_INDIRECT = 1 << 5,
+	SHADER_LOD_DITHER = 1 << 6
+};
+
+#define SHADER_FEATURE_COUNT 7
+#define SHADER_VARIANT_COUNT (1 << SHADER_FEATURE_COUNT)
+
+//features that change the vertex inputs, a fallback has to keep them
+#define SHADER_INTERFACE_FEATURES (SHADER_INSTANCED | SHADER_INDIRECT)
+
+//all permutations of one vertex/fragment source. Variants are only built when
+//first asked for, in the background; until then get() returns a fallback
+class ShaderLibrary
+{
+public:
+	ShaderLibrary(const char* vertexPath, const char* fragmentPath);
+	~ShaderLibrary();
+
+	//used when the driver can't compile in parallel, the library owns the context
+	void setWorkerContext(GLFWwindow* context);
+
+	Shader& get(unsigned int features);
+	bool isReady(unsigned int features) const;
+
+	//picks up finished builds, call once per frame
+	void update();
+
+	static std::string makeDefines(unsigned int features);
+
+private:
+	enum VariantState
+	{
+		VARIANT_UNUSED,
+		VARIANT_BUILDING,
+		VARIANT_READY,
+		VARIANT_FAILED
+	};
+
+	struct Variant
+	{
+		Shader* shader;
+		VariantState state;
+		ShaderBuild build;
+		uint64_t key;
+	};
+
+	struct WorkerJob
+	{
+		unsigned int features;
+		std::string vertexCode;
+		std::string fragmentCode;
+	};
+
+	struct WorkerResult
+	{
+		unsigned int features;
+		unsigned int program;
+	};
+
+	std::string vertexSource;
+	std::string fragmentSource;
+	uint64_t vertexHash;
+	uint64_t fragmentHash;
+	Variant variants[SHADER_VARIANT_COUNT];
+	bool parallelCompile;
+
+	GLFWwindow* workerContext;
+	std::thread worker;
+	std::mutex workerMutex;
+	std::condition_variable workerWake;
+	std::deque<WorkerJob> jobs;
+	std::vector<WorkerResult> results;
+	bool stopWorker;
+
+	void request(unsigned int features, bool wait);
+	void finish(unsigned int features, unsigned int program, bool compiled);
+	void workerLoop();
+};
@@ -0,0 +1,132 @@
+#include "shaderLod.h"
+#include <iostream>
+
+static const unsigned int lodFeatures[SHADER_LOD_LEVELS] =
+{
+	0,
+	SHADER_NO_SPECULAR,
+	SHADER_VERTEX_LIGHTING | SHADER_NO_SPECULAR
+};
+
+//rough scalar ALU ops per invocation, counted from vertex_shader.glsl/fragment_shader.glsl.
+//sunShadow() is about 31 of them (distance 7, split tests 3, cascade transform 16, compare 5)
+//plus 3 per shadowed term; the vertex-lit level runs it per vertex instead of per pixel
+static const double fragmentCost[SHADER_LOD_LEVELS] = { 89.0, 61.0, 6.0 };
+static const double vertexCost[SHADER_LOD_LEVELS] = { 47.0, 47.0, 104.0 };
+//the old vertex shader ran transpose(inverse(model)) for every vertex
+static const double oldVertexCost = 150.0;
+
+ShaderLod::ShaderLod()
+	: noSpecularPixels(120.0f), vertexLightingPixels(30.0f), pixelScale(1.0f), screenPixels(1.0f), cameraPos(0.0f)
+{
+	beginFrame(glm::mat4(1.0f), 1, 1, glm::vec3(0.0f));
+}
+
+void ShaderLod::beginFrame(const glm::mat4& projection, int viewportWidth, int viewportHeight, const glm::vec3& cameraPos)
+{
+	//projection[1][1] = 1 / tan(fov / 2), so radius * pixelScale / distance is the radius in pixels
+	this->pixelScale = projection[1][1] * 0.5f * (float)viewportHeight;
+	this->screenPixels = (float)viewportWidth * (float)viewportHeight;
+	this->cameraPos = cameraPos;
+
+	for (int i = 0; i < SHADER_LOD_LEVELS; i++)
+	{
+		objects[i] = 0;
+		pixels[i] = 0.0;
+		vertices[i] = 0.0;
+	}
+}
+
+ShaderLod ShaderLod::fork() const
+{
+	ShaderLod copy = *this;
+	for (int i = 0; i < SHADER_LOD_LEVELS; i++)
+	{
+		copy.objects[i] = 0;
+		copy.pixels[i] = 0.0;
+		copy.vertices[i] = 0.0;
+	}
+	return copy;
+}
+
+void ShaderLod::merge(const ShaderLod& other)
+{
+	for (int i = 0; i < SHADER_LOD_LEVELS; i++)
+	{
+		objects[i] += other.objects[i];
+		pixels[i] += other.pixels[i];
+		vertices[i] += other.vertices[i];
+	}
+}
+
+int ShaderLod::levelOf(const glm::vec3& center, float radius, float& projected) const
+{
+	float distance = glm::max(glm::length(center - cameraPos) - radius, 0.001f);
+	projected = radius * pixelScale / distance;
+
+	if (projected < vertexLightingPixels)
+		return SHADER_LOD_VERTEX;
+	if (projected < noSpecularPixels)
+		return SHADER_LOD_NO_SPECULAR;
+	return SHADER_LOD_FULL;
+}
+
+void ShaderLod::record(int level, float projected, unsigned int vertexCount)
+{
+	objects[level]++;
+	pixels[level] += glm::min(3.14159f * projected * projected, screenPixels);
+	vertices[level] += vertexCount;
+}
+
+int ShaderLod::selectLevel(const glm::vec3& center, float radius, unsigned int vertexCount)
+{
+	float projected;
+	int level = levelOf(center, radius, projected);
+	record(level, projected, vertexCount);
+	return level;
+}
+
+int ShaderLod::peekLevel(const glm::vec3& center, float radius) const
+{
+	float projected;
+	return levelOf(center, radius, projected);
+}
+
+unsigned int ShaderLod::select(const glm::vec3& center, float radius, unsigned int vertexCount)
+{
+	return lodFeatures[selectLevel(center, radius, vertexCount)];
+}
+
+unsigned int ShaderLod::getFeatures(int level)
+{
+	return lodFeatures[level];
+}
+
+void ShaderLod::printReport()
+{
+	double fragmentNow = 0.0, fragmentFull = 0.0;
+	double vertexNow = 0.0, vertexOld = 0.0;
+
+	std::cout << "Shader LOD:";
+	for (int i = 0; i < SHADER_LOD_LEVELS; i++)
+	{
+		std::cout << " level " << i << " = " << objects[i] << " objects";
+
+		fragmentNow += pixels[i] * fragmentCost[i];
+		fragmentFull += pixels[i] * fragmentCost[SHADER_LOD_FULL];
+		vertexNow += vertices[i] * vertexCost[i];
+		vertexOld += vertices[i] * oldVertexCost;
+	}
+	std::cout << std::endl;
+
+	if (fragmentFull > 0.0)
+	{
+		std::cout << "  fragment ALU " << fragmentNow / 1e6 << "M vs " << fragmentFull / 1e6
+			<< "M full lighting (" << 100.0 * (1.0 - fragmentNow / fragmentFull) << "% saved)" << std::endl;
+	}
+	if (vertexOld > 0.0)
+	{
+		std::cout << "  vertex ALU " << vertexNow / 1e6 << "M vs " << vertexOld / 1e6
+			<< "M with per-vertex inverse (" << 100.0 * (1.0 - vertexNow / vertexOld) << "% saved)" << std::endl;
+	}
+}
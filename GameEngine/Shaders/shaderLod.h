@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm.hpp>
+#include "shaderLibrary.h"
+
+#define SHADER_LOD_LEVELS 3
+
+//lighting paths from most to least expensive
+enum ShaderLodLevel
+{
+	SHADER_LOD_FULL,        // per-pixel ambient + diffuse + specular
+	SHADER_LOD_NO_SPECULAR, // per-pixel ambient + diffuse
+	SHADER_LOD_VERTEX       // ambient + diffuse per vertex, shadows sampled per vertex
+};
+
+//picks a cheaper lighting variant for objects that are small on screen
+class ShaderLod
+{
+public:
+	//projected radius in pixels at which an object drops to the next level
+	float noSpecularPixels;
+	float vertexLightingPixels;
+
+	ShaderLod();
+
+	void beginFrame(const glm::mat4& projection, int viewportWidth, int viewportHeight, const glm::vec3& cameraPos);
+
+	//returns the shader feature bits for an object and records it for the report
+	unsigned int select(const glm::vec3& center, float radius, unsigned int vertexCount);
+	//same, returning the ShaderLodLevel, for callers that bucket instances per level
+	int selectLevel(const glm::vec3& center, float radius, unsigned int vertexCount);
+	//the level without recording, for a second part of an object already selected
+	int peekLevel(const glm::vec3& center, float radius) const;
+
+	static unsigned int getFeatures(int level);
+
+	//same frame settings with empty counts, for a worker thread to select with;
+	//merge() adds its counts back afterwards
+	ShaderLod fork() const;
+	void merge(const ShaderLod& other);
+
+	//estimated vertex/fragment ALU of the current frame against full lighting everywhere
+	void printReport();
+
+private:
+	int levelOf(const glm::vec3& center, float radius, float& projected) const;
+	void record(int level, float projected, unsigned int vertexCount);
+
+	float pixelScale;
+	float screenPixels;
+	glm::vec3 cameraPos;
+
+	unsigned int objects[SHADER_LOD_LEVELS];
+	double pixels[SHADER_LOD_LEVELS];
+	double vertices[SHADER_LOD_LEVELS];
+};
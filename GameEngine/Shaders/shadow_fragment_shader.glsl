@@ -0,0 +1,6 @@
+#version 400
+
+//depth only, the framebuffer has no color buffer
+void main()
+{
+}
@@ -0,0 +1,15 @@
+#version 400
+
+//packed arena vertex, see Graphics/vertexFormat.h; only the position matters here
+layout (location = 0) in vec3 pos; // snorm16, dequantized with meshDequant
+
+uniform vec4 meshDequant;
+//identity for the world space scenery batches
+uniform mat4 casterModel;
+//orthographic view of one cascade, no FrameData here: the cascades have their own
+uniform mat4 lightViewProj;
+
+void main()
+{
+	gl_Position = lightViewProj * casterModel * vec4(pos * meshDequant.w + meshDequant.xyz, 1.0f);
+}
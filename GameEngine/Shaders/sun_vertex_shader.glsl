@@ -1,11 +1,28 @@
 #version 400
 
-layout (location = 0) in vec3 pos;
+layout (location = 0) in vec3 pos; // snorm16, dequantized with meshDequant
 
+uniform vec4 meshDequant;
 
-uniform mat4 MVP;
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 lightPos;
+	vec4 lightColor;
+	vec4 viewPos;
+	vec4 time;
+	vec4 fogColor;
+};
+
+layout (std140) uniform ObjectData
+{
+	mat4 model;
+	mat4 normalMatrix;
+};
 
 void main()
 {
-    gl_Position = MVP * vec4(pos, 1.0f);
+    gl_Position = viewProj * model * vec4(pos * meshDequant.w + meshDequant.xyz, 1.0f);
 }
\ No newline at end of file
@@ -1,20 +1,132 @@
 #version 400
+#ifdef INDIRECT
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 
-layout (location = 0) in vec3 pos;
-layout (location = 1) in vec3 normals;
-layout (location = 2) in vec2 texCoord;
+//packed arena vertex, see Graphics/vertexFormat.h
+layout (location = 0) in vec3 pos;     // snorm16, dequantized with meshDequant
+layout (location = 1) in vec2 normals; // snorm16 octahedral
+layout (location = 2) in vec2 texCoord; // half float
+#ifdef INSTANCED
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in mat3 instanceNormalMatrix;
+#endif
+#ifdef INDIRECT
+//record of baseInstance + gl_InstanceID, read from an index buffer with divisor 1
+layout (location = 10) in uint objectIndex;
+#endif
 
 out vec2 textureCoord;
 out vec3 norm;
 out vec3 fragPos;
+#ifdef VERTEX_LIGHTING
+out vec3 lighting;
 
-uniform mat4 MVP;
-uniform mat4 model;
+//the sun's cascades, always on SHADOW_MAP_UNIT
+uniform sampler2DArrayShadow shadowMap;
+#endif
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 lightPos;
+	vec4 lightColor;
+	vec4 viewPos;
+	vec4 time;
+	vec4 fogColor;
+	mat4 shadowMatrices[3]; // SHADOW_CASCADES
+	vec4 shadowSplits;
+};
+
+layout (std140) uniform ObjectData
+{
+	mat4 model;
+	mat4 normalMatrix; // transpose(inverse(model)), computed on the CPU
+};
+
+#ifdef INDIRECT
+//same layout as ObjectData, one record per object of a multi-draw
+struct ObjectRecord
+{
+	mat4 model;
+	mat4 normalMatrix;
+};
+
+layout (std430) readonly buffer ObjectRecords
+{
+	ObjectRecord objects[];
+};
+
+//this frame's region of the dynamic record ring
+layout (std430) readonly buffer DynamicRecords
+{
+	ObjectRecord dynamicObjects[];
+};
+#endif
+
+#ifdef VERTEX_LIGHTING
+//same as in fragment_shader.glsl, sampled once per vertex and interpolated so objects
+//keep their shadows when they drop to vertex lighting inside the cascades
+float sunShadow(vec3 worldPos)
+{
+	float distance = length(viewPos.xyz - worldPos);
+	for (int i = 0; i < 3; i++)
+	{
+		if (distance < shadowSplits[i])
+		{
+			vec4 coord = shadowMatrices[i] * vec4(worldPos, 1.0f);
+			return texture(shadowMap, vec4(coord.xy, float(i), coord.z - 0.0002f));
+		}
+	}
+	return 1.0f;
+}
+#endif
+
+//position = pos * w + xyz, per mesh (INDIRECT records have it folded into the model)
+uniform vec4 meshDequant;
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
 
 void main()
 {
+#if defined(INDIRECT)
+	//the high bit marks records streamed this frame, see INDIRECT_DYNAMIC_RECORD
+	ObjectRecord record = (objectIndex & 0x80000000u) != 0u ?
+		dynamicObjects[objectIndex & 0x7fffffffu] : objects[objectIndex];
+	mat4 world = record.model;
+	mat3 worldNormal = mat3(record.normalMatrix);
+#elif defined(INSTANCED)
+	mat4 world = instanceModel;
+	mat3 worldNormal = instanceNormalMatrix;
+#else
+	mat4 world = model;
+	mat3 worldNormal = mat3(normalMatrix);
+#endif
+
+#ifdef INDIRECT
+	vec3 position = pos;
+#else
+	vec3 position = pos * meshDequant.w + meshDequant.xyz;
+#endif
+
 	textureCoord = texCoord;
-	fragPos = vec3(model * vec4(pos, 1.0f));
-	norm = mat3(transpose(inverse(model)))*normals;
-	gl_Position = MVP * vec4(pos, 1.0f);
+	fragPos = vec3(world * vec4(position, 1.0f));
+	norm = worldNormal * decodeOctahedral(normals);
+	gl_Position = viewProj * vec4(fragPos, 1.0f);
+
+#ifdef VERTEX_LIGHTING
+	//cheap path for distant objects: ambient + shadowed diffuse once per vertex
+	vec3 lightDir = normalize(lightPos.xyz - fragPos);
+	float diff = max(dot(normalize(norm), lightDir), 0.0f);
+	lighting = (0.5f + diff * sunShadow(fragPos)) * lightColor.rgb;
+#endif
 }
\ No newline at end of file
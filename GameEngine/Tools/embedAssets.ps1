@@ -0,0 +1,81 @@
+# Pre-build step: compiles Shaders/*.glsl and the files listed in embeddedAssets.txt
+# into Generated/embeddedAssetData.h, read at runtime through Assets (Model Loading/assets.h).
+# The header is only rewritten when its contents change so unchanged builds stay incremental.
+param(
+	[Parameter(Mandatory = $true)][string]$ProjectDir
+)
+
+$ErrorActionPreference = "Stop"
+$maxAssetSize = 512KB
+
+$ProjectDir = $ProjectDir.TrimEnd('\', '/')
+$manifest = Join-Path $ProjectDir "Tools\embeddedAssets.txt"
+$outputDir = Join-Path $ProjectDir "Generated"
+$output = Join-Path $outputDir "embeddedAssetData.h"
+
+# project relative paths with forward slashes, as the game passes them to Assets::read
+$paths = New-Object System.Collections.Generic.List[string]
+Get-ChildItem -Path (Join-Path $ProjectDir "Shaders") -Filter "*.glsl" | Sort-Object Name | ForEach-Object {
+	$paths.Add("Shaders/" + $_.Name)
+}
+if (Test-Path $manifest) {
+	foreach ($line in Get-Content $manifest) {
+		$line = $line.Trim()
+		if ($line.Length -eq 0 -or $line.StartsWith("#")) { continue }
+		$paths.Add($line.Replace('\', '/'))
+	}
+}
+
+$sha = [System.Security.Cryptography.SHA256]::Create()
+$text = New-Object System.Text.StringBuilder
+[void]$text.AppendLine("// Generated by Tools/embedAssets.ps1, do not edit")
+[void]$text.AppendLine("#pragma once")
+[void]$text.AppendLine("")
+
+$entries = New-Object System.Collections.Generic.List[string]
+$index = 0
+foreach ($path in $paths) {
+	$file = Join-Path $ProjectDir $path.Replace('/', '\')
+	if (-not (Test-Path $file)) {
+		Write-Warning "embedAssets: $path not found, it will be read from disk"
+		continue
+	}
+	$bytes = [System.IO.File]::ReadAllBytes($file)
+	if ($bytes.Length -gt $maxAssetSize) {
+		Write-Warning "embedAssets: $path is larger than 512 KB, it will be read from disk"
+		continue
+	}
+
+	# first 64 bits of the SHA-256, used as the shader cache key
+	$digest = $sha.ComputeHash($bytes)
+	$hash = ($digest[0..7] | ForEach-Object { $_.ToString("x2") }) -join ""
+
+	$name = "asset$index"
+	[void]$text.AppendLine("// $path")
+	[void]$text.Append("static constexpr unsigned char $name[] = {")
+	for ($i = 0; $i -lt $bytes.Length; $i++) {
+		if ($i % 24 -eq 0) { [void]$text.Append("`n`t") }
+		[void]$text.Append($bytes[$i]).Append(",")
+	}
+	# terminator so text assets can be used as C strings
+	[void]$text.AppendLine("0`n};")
+	[void]$text.AppendLine("")
+
+	$entries.Add("`t{ `"$path`", $name, $($bytes.Length), 0x$($hash)ULL },")
+	$index++
+}
+
+[void]$text.AppendLine("static constexpr EmbeddedAsset generatedAssets[] = {")
+foreach ($entry in $entries) { [void]$text.AppendLine($entry) }
+[void]$text.AppendLine("`t{ NULL, NULL, 0, 0 }")
+[void]$text.AppendLine("};")
+
+$content = $text.ToString()
+if ((Test-Path $output) -and ([System.IO.File]::ReadAllText($output) -eq $content)) {
+	Write-Host "embedAssets: $index assets up to date"
+	exit 0
+}
+
+New-Item -ItemType Directory -Force -Path $outputDir | Out-Null
+[System.IO.File]::WriteAllText($output, $content)
+Write-Host "embedAssets: wrote $index assets to Generated\embeddedAssetData.h"
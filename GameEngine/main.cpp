@@ -1,16 +1,36 @@
 #include "Graphics/window.h"
 #include "Camera/camera.h"
 #include "Shaders/shader.h"
+#include "Shaders/shaderLibrary.h"
+#include "Shaders/shaderLod.h"
 #include "Model Loading/mesh.h"
 #include "Model Loading/texture.h"
 #include "Model Loading/meshLoaderObj.h"
+#include "Graphics/uniformBuffer.h"
+#include "Graphics/instanceBuffer.h"
+#include "Graphics/indirectRenderer.h"
+#include "Graphics/ringBuffer.h"
+#include "Graphics/staticBatcher.h"
+#include "Graphics/renderQueue.h"
+#include "Graphics/glState.h"
+#include "Graphics/cullingSet.h"
+#include "Graphics/boundsTree.h"
+#include "Graphics/occlusionCuller.h"
+#include "Graphics/lodSelector.h"
+#include "Graphics/impostor.h"
+#include "Graphics/jobPool.h"
+#include "Graphics/commandList.h"
+#include "Graphics/framePipeline.h"
+#include "Graphics/shadowCascades.h"
 #include <../glm/gtc/matrix_transform.hpp>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
-void processKeyboardInput();
 void handleMouseInput();
 
+// Only the simulation step reads or completes these
 struct Task {
     std::string story;              // Story description
     std::string objective;          // Task description
@@ -80,11 +100,13 @@ float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
 Window window("Game Engine", 1600, 900);
-Camera camera;
+
+// Mouse movement since the last input sample, the camera itself belongs to the game state
+float mouseYaw = 0.0f;
+float mousePitch = 0.0f;
 
 // Light info
 glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-glm::vec3 lightPos = glm::vec3(30.0f, 180.0f, 50.0f);
 
 // ------------------------------------------------
 // Mouse callback
@@ -107,12 +129,11 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     offsetX *= sensitivity;
     offsetY *= sensitivity;
 
-    camera.rotateOy(offsetX); // yaw
-    camera.rotateOx(offsetY); // pitch
+    mouseYaw += offsetX; // yaw
+    mousePitch += offsetY; // pitch
 }
 
 //  Day-night cycle
-float dayNightTime = 0.0f;   // increments each frame
 float cycleDuration = 60.0f; // 60 seconds for a full day-night cycle
 
 // Meteors
@@ -123,7 +144,14 @@ struct Meteor {
     bool      active;
 };
 
-std::vector<Meteor> meteors;
+// Renderables in the scene tree, the top bits of a leaf's data say what it is
+const unsigned int SCENE_FOREST = 0u << 30;  // forest entry, trunks then crowns
+const unsigned int SCENE_METEOR = 1u << 30;  // index into meteors
+const unsigned int SCENE_DINO = 2u << 30;
+const unsigned int SCENE_KIND = 3u << 30;
+
+// How far a moving object's box is grown, it is only reinserted after leaving it
+const float sceneTreeMargin = 10.0f;
 
 // Return random float in [low, high]
 float randBetween(float low, float high) {
@@ -131,7 +159,7 @@ float randBetween(float low, float high) {
     return low + r * (high - low);
 }
 
-void spawnMeteor() {
+void spawnMeteor(std::vector<Meteor>& meteors) {
     Meteor m;
     // Position high above the map
     float x = randBetween(-300.0f, 300.0f);
@@ -152,7 +180,7 @@ void spawnMeteor() {
     meteors.push_back(m);
 }
 
-void updateMeteors(float dt) {
+void updateMeteors(std::vector<Meteor>& meteors, float dt) {
     for (auto& m : meteors) {
         if (!m.active) continue;
 
@@ -164,52 +192,361 @@ void updateMeteors(float dt) {
     }
 }
 
-void drawMeteors(Shader& meteorShader, Mesh& meteorMesh,
-    const glm::mat4& ProjectionMatrix,
-    const glm::mat4& ViewMatrix,
-    GLuint MatrixID, GLuint ModelMatrixID)
+glm::mat4 meteorMatrix(const Meteor& m) {
+    glm::mat4 Model = glm::mat4(1.0f);
+    Model = glm::translate(Model, m.position);
+    return glm::scale(Model, glm::vec3(m.scale));
+}
+
+// Inserts, moves and removes the meteor leaves to match the simulation. The leaves
+// belong to the render side, proxies[i] is meteor i's while it is active
+void trackMeteors(BoundsTree& sceneTree, const Mesh& meteorMesh, const std::vector<Meteor>& meteors,
+    std::vector<int>& proxies)
 {
-    for (auto& m : meteors) {
-        if (!m.active) continue;
+    proxies.resize(meteors.size(), BOUNDS_TREE_NULL);
+    for (unsigned int i = 0; i < meteors.size(); ++i) {
+        const Meteor& m = meteors[i];
+        if (!m.active) {
+            if (proxies[i] != BOUNDS_TREE_NULL) {
+                sceneTree.remove(proxies[i]);
+                proxies[i] = BOUNDS_TREE_NULL;
+            }
+            continue;
+        }
+
+        glm::vec3 center, extent;
+        float radius;
+        CullingSet::transform(meteorMesh, meteorMatrix(m), center, extent, radius);
+        if (proxies[i] == BOUNDS_TREE_NULL)
+            proxies[i] = sceneTree.insert(center - extent, center + extent, SCENE_METEOR | i, sceneTreeMargin);
+        else
+            sceneTree.update(proxies[i], center - extent, center + extent, sceneTreeMargin);
+    }
+}
+
+// Submits the object's current LOD level; during a crossfade also the level fading
+// out, both through the dithered variant so each pixel comes from exactly one of them.
+// While that variant still builds the fallback would draw both levels whole, so only
+// the incoming one is drawn and the fade pops instead
+void submitLod(RenderQueue& queue, ShaderLibrary& shaders, unsigned int features, const Mesh& source,
+    const MeshLod& lod, const LodState& state, const glm::mat4& model, const glm::vec3& center)
+{
+    const Mesh& mesh = lod.getLevel(source, state.level);
+    if (state.previous < 0 || !shaders.isReady(features | SHADER_LOD_DITHER)) {
+        if (state.previous >= 0)
+            shaders.get(features | SHADER_LOD_DITHER);
+        queue.submit(RENDER_PASS_OPAQUE, shaders.get(features), mesh, model, center);
+        return;
+    }
+
+    // a fade of exactly 0 would mean "no dither"
+    float fade = glm::max(state.fade, 0.001f);
+    Shader& dithered = shaders.get(features | SHADER_LOD_DITHER);
+    queue.submit(RENDER_PASS_OPAQUE, dithered, mesh, model, center, fade);
+    queue.submit(RENDER_PASS_OPAQUE, dithered, lod.getLevel(source, state.previous), model, center, -fade);
+}
 
-        glm::mat4 Model = glm::mat4(1.0f);
-        Model = glm::translate(Model, m.position);
-        Model = glm::scale(Model, glm::vec3(m.scale));
-        glm::mat4 MVP = ProjectionMatrix * ViewMatrix * Model;
+void drawMeteors(ShaderLibrary& shaders, ShaderLod& shaderLod, Mesh& meteorMesh,
+    InstanceBuffer& meteorInstances, const std::vector<const Meteor*>& visible)
+{
+    // Bucket the visible meteors per lighting level, then one instanced draw per level
+    std::vector<InstanceData> levels[SHADER_LOD_LEVELS];
+    for (const Meteor* m : visible) {
+        int level = shaderLod.selectLevel(m->position,
+            meteorMesh.boundingRadius * m->scale, meteorMesh.vertexCount);
+
+        levels[level].push_back(InstanceData(meteorMatrix(*m)));
+    }
+
+    unsigned int total = 0;
+    for (int level = 0; level < SHADER_LOD_LEVELS; ++level)
+        total += levels[level].size();
 
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &Model[0][0]);
+    // written straight into this frame's ring region
+    meteorInstances.begin(total);
+    for (int level = 0; level < SHADER_LOD_LEVELS; ++level) {
+        for (auto& instance : levels[level])
+            meteorInstances.add(instance);
+    }
+
+    unsigned int first = 0;
+    for (int level = 0; level < SHADER_LOD_LEVELS; ++level) {
+        unsigned int count = levels[level].size();
+        if (count == 0) continue;
 
-        meteorMesh.draw(meteorShader);
+        Shader& meteorShader = shaders.get(SHADER_INSTANCED | ShaderLod::getFeatures(level));
+        meteorShader.use();
+        meteorInstances.draw(meteorMesh, meteorShader, first, count);
+        first += count;
     }
 }
 
-void drawSkySphere(Mesh& sphereMesh,
-    Shader& shader,
-    const glm::vec3& cameraPos,
-    const glm::mat4& projection)
+// Trees are a trunk and a crown sharing the position
+glm::mat4 treeTrunkMatrix(const glm::vec3& position)
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    return glm::scale(model, glm::vec3(5.0f));
+}
+
+glm::mat4 treeCrownMatrix(const glm::vec3& position)
 {
-    glm::mat4 noRotView = glm::translate(glm::mat4(1.0f), -cameraPos);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position + glm::vec3(0.0f, -4.0f, 0.0f));
+    return glm::scale(model, glm::vec3(5.0f));
+}
+
+// Forest entries are trunks at [0, count) and crowns right after them. The packets
+// use the entry as object and 0/1 (trunk/crown) as mesh, impostors the tree index.
+// Everything a worker reads while the forest is recorded, nothing in it changes then
+struct ForestFrame {
+    const std::vector<unsigned int>* visible; // entries that passed the frustum, ascending
+    const glm::vec3* positions;
+    const glm::vec3* lows;
+    const glm::vec3* highs;
+    unsigned int count;
+    glm::vec3 cameraPos;
+    float impostorDistance; // trees past it become impostors, 0 without an impostor
+    float treeRadius;
+    unsigned int treeVertices;
+    const OcclusionCuller* occlusion;
+};
 
-    shader.use();
-    GLint viewLoc = glGetUniformLocation(shader.getId(), "noRotView");
-    GLint projLoc = glGetUniformLocation(shader.getId(), "projection");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &noRotView[0][0]);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projection[0][0]);
+// Worker side: occlusion, impostor distance and lighting level of the visible entries
+// in [begin, end). Slices are ascending, so merged lists keep trunks before crowns
+void recordTrees(const ForestFrame& forest, unsigned int begin, unsigned int end, ShaderLod& shaderLod,
+    CommandList& commands, unsigned int& tested, unsigned int& occluded)
+{
+    const std::vector<unsigned int>& visible = *forest.visible;
+    for (unsigned int i = begin; i < end; ++i) {
+        unsigned int entry = visible[i];
+        bool crown = entry >= forest.count;
+        unsigned int tree = crown ? entry - forest.count : entry;
+
+        if (forest.impostorDistance > 0.0f &&
+            glm::length(forest.positions[tree] - forest.cameraPos) >= forest.impostorDistance) {
+            // trunk and crown are one impostor, recorded by the trunk unless the frustum dropped it
+            if (crown && std::binary_search(visible.begin(), visible.end(), tree)) continue;
+
+            unsigned int other = crown ? tree : tree + forest.count;
+            tested++;
+            if (!forest.occlusion->testBox(glm::min(forest.lows[entry], forest.lows[other]),
+                glm::max(forest.highs[entry], forest.highs[other]))) {
+                occluded++;
+                continue;
+            }
+            commands.add(DRAW_PACKET_IMPOSTOR, 0, 0, tree);
+            continue;
+        }
 
-    // Build a big model matrix so it encloses your map
+        tested++;
+        if (!forest.occlusion->testBox(forest.lows[entry], forest.highs[entry])) {
+            occluded++;
+            continue;
+        }
+        // the tree is counted once for the report, by its trunk when that is visible
+        int level = crown && std::binary_search(visible.begin(), visible.end(), tree)
+            ? shaderLod.peekLevel(forest.positions[tree], forest.treeRadius)
+            : shaderLod.selectLevel(forest.positions[tree], forest.treeRadius, forest.treeVertices);
+        commands.add(DRAW_PACKET_MESH, level, crown ? 1 : 0, entry);
+    }
+}
+
+// Per-thread parts and results of the scene tree query
+struct SceneQuery {
+    std::vector<BoundsSubtree> subtrees;
+    std::vector<std::vector<unsigned int>> visible;
+    std::vector<BoundsQueryCounts> counts;
+};
+
+// The frustum opens the top of the tree into a few subtrees per thread, the threads query
+// slices of them and the leaves come back in thread order, the same for the same view
+void queryScene(JobPool& jobs, BoundsTree& tree, const Frustum& frustum, SceneQuery& query,
+    std::vector<unsigned int>& visible)
+{
+    unsigned int threads = jobs.getThreadCount();
+    query.visible.resize(threads);
+    query.counts.resize(threads);
+    for (unsigned int t = 0; t < threads; ++t) {
+        query.visible[t].clear();
+        query.counts[t] = BoundsQueryCounts();
+    }
+
+    tree.split(frustum, jobs.getActiveThreads() * 4, query.subtrees);
+    jobs.run(query.subtrees.size(), [&](unsigned int thread, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i)
+            tree.query(frustum, query.subtrees[i], query.visible[thread], query.counts[thread]);
+    });
+
+    visible.clear();
+    for (unsigned int t = 0; t < threads; ++t) {
+        visible.insert(visible.end(), query.visible[t].begin(), query.visible[t].end());
+        tree.addCounts(query.counts[t]);
+    }
+}
+
+// F8: CPU time of the threaded culling of this view (scene tree query, then occlusion,
+// impostor distance and lighting level of the visible forest) with 1 thread up to all of them
+void runCullingScaling(JobPool& jobs, BoundsTree& tree, const Frustum& frustum, SceneQuery& query,
+    const ForestFrame* forest, const ShaderLod& shaderLod)
+{
+    const int repeats = 20;
+    unsigned int threads = jobs.getThreadCount();
+    std::vector<unsigned int> visible;
+    std::vector<CommandList> commands(threads);
+    std::vector<ShaderLod> lods(threads);
+    std::vector<unsigned int> tested(threads), occluded(threads);
+
+    std::cout << "Culling scaling, " << repeats << " runs per thread count"
+        << (forest != NULL ? "" : ", forest off") << ":" << std::endl;
+    double single = 0.0;
+    for (unsigned int active = 1; active <= threads; ++active) {
+        jobs.setThreadLimit(active);
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for (int run = 0; run < repeats; ++run) {
+            queryScene(jobs, tree, frustum, query, visible);
+            if (forest == NULL) continue;
+
+            for (unsigned int t = 0; t < threads; ++t) {
+                commands[t].clear();
+                lods[t] = shaderLod.fork();
+            }
+            jobs.run(forest->visible->size(), [&](unsigned int thread, unsigned int begin, unsigned int end) {
+                recordTrees(*forest, begin, end, lods[thread], commands[thread], tested[thread], occluded[thread]);
+            });
+        }
+        double ms = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0 / repeats;
+        if (active == 1)
+            single = ms;
+        std::cout << "  " << active << " threads: " << ms << " ms per frame, " << (ms > 0.0 ? single / ms : 0.0)
+            << "x of 1 thread" << std::endl;
+    }
+    jobs.setThreadLimit(0);
+}
+
+// GL side, multi-draw path: the forest records start at first, in the same layout as the
+// entries. Neighbouring records of one mesh and level merge into one command
+void replayTreesIndirect(IndirectRenderer& indirect, const std::vector<CommandList>& lists, unsigned int first,
+    Mesh& trunk, Mesh& crown, std::vector<unsigned int>& impostorTrees)
+{
+    for (const CommandList& list : lists) {
+        for (unsigned int i = 0; i < list.size(); ++i) {
+            const DrawPacket& packet = list[i];
+            if (packet.type == DRAW_PACKET_IMPOSTOR)
+                impostorTrees.push_back(packet.object);
+            else
+                indirect.draw(packet.level, packet.mesh ? crown : trunk, first + packet.object, 1);
+        }
+    }
+}
+
+// GL side, instanced path: the instances are streamed, trunks first, one draw per mesh.
+// One lighting variant for everything, the closest tree decides
+void replayTreesInstanced(ShaderLibrary& shaders, InstanceBuffer& instances, const std::vector<InstanceData>& forest,
+    const std::vector<CommandList>& lists, Mesh& trunk, Mesh& crown, std::vector<unsigned int>& impostorTrees)
+{
+    unsigned int meshPackets = 0;
+    int level = SHADER_LOD_LEVELS - 1;
+    for (const CommandList& list : lists) {
+        for (unsigned int i = 0; i < list.size(); ++i) {
+            if (list[i].type == DRAW_PACKET_MESH) {
+                meshPackets++;
+                level = glm::min(level, (int)list[i].level);
+            }
+        }
+    }
+
+    unsigned int trunks = 0;
+    instances.begin(meshPackets);
+    for (const CommandList& list : lists) {
+        for (unsigned int i = 0; i < list.size(); ++i) {
+            const DrawPacket& packet = list[i];
+            if (packet.type == DRAW_PACKET_IMPOSTOR) {
+                impostorTrees.push_back(packet.object);
+                continue;
+            }
+            instances.add(forest[packet.object]);
+            if (packet.mesh == 0) trunks++;
+        }
+    }
+    if (meshPackets == 0) return;
+
+    Shader& treeShader = shaders.get(SHADER_INSTANCED | ShaderLod::getFeatures(level));
+    treeShader.use();
+    instances.draw(trunk, treeShader, 0, trunks);
+    instances.draw(crown, treeShader, trunks, meshPackets - trunks);
+}
+
+void queueMeteors(IndirectRenderer& indirect, ShaderLod& shaderLod, Mesh& meteorMesh,
+    const std::vector<const Meteor*>& visible)
+{
+    for (const Meteor* m : visible) {
+        int level = shaderLod.selectLevel(m->position,
+            meteorMesh.boundingRadius * m->scale, meteorMesh.vertexCount);
+
+        glm::mat4 Model = meteorMatrix(*m);
+        indirect.draw(level, meteorMesh, indirect.push(meteorMesh, Model), 1);
+    }
+}
+
+// Benchmark forest: trunk matrices followed by crown matrices, uploaded once like the regular trees
+void buildForest(std::vector<glm::vec3>& positions, std::vector<glm::mat4>& matrices, int count)
+{
+    positions.clear();
+    for (int i = 0; i < count; ++i)
+        positions.push_back(glm::vec3(randBetween(-1000.0f, 1000.0f), -20.0f, randBetween(-1000.0f, 1000.0f)));
+
+    matrices.clear();
+    matrices.reserve(count * 2);
+    for (int i = 0; i < count; ++i)
+        matrices.push_back(treeTrunkMatrix(positions[i]));
+    for (int i = 0; i < count; ++i)
+        matrices.push_back(treeCrownMatrix(positions[i]));
+}
+
+// The sky pass draws it last with GL_LEQUAL, behind everything
+glm::mat4 skySphereMatrix(const glm::vec3& cameraPos)
+{
+    // Build a big model matrix around the camera so it encloses your map
     float bigRadius = 5000.0f; // or whichever is large enough
-    glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(bigRadius));
-    GLint modelLoc = glGetUniformLocation(shader.getId(), "model");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &model[0][0]);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), cameraPos);
+    return glm::scale(model, glm::vec3(bigRadius));
+}
 
-    glDepthFunc(GL_LEQUAL); // ensures it's drawn behind everything
+// F5: occlusion rates along a fixed circle inside the wall, looking along the path.
+// The occludees are a grid of tree sized boxes, so runs compare across builds
+void runOcclusionBenchmark(OcclusionCuller& occlusion, const glm::mat4& projection)
+{
+    std::vector<glm::vec3> lows, highs;
+    for (int x = -1000; x <= 1000; x += 40) {
+        for (int z = -1000; z <= 1000; z += 40) {
+            lows.push_back(glm::vec3((float)x - 5.0f, -20.0f, (float)z - 5.0f));
+            highs.push_back(glm::vec3((float)x + 5.0f, 20.0f, (float)z + 5.0f));
+        }
+    }
 
-    // draw
-    sphereMesh.draw(shader);
+    const int views = 64;
+    unsigned int inFrustum = 0, occluded = 0;
+    double rasterSeconds = 0.0;
+    for (int view = 0; view < views; ++view) {
+        float pathAngle = 2.0f * 3.14159f * view / views;
+        glm::vec3 eye = wallCenter + glm::vec3(150.0f * cos(pathAngle), 4.0f, 150.0f * sin(pathAngle));
+        glm::vec3 along = glm::vec3(-sin(pathAngle), 0.0f, cos(pathAngle));
+        glm::mat4 viewProj = projection * glm::lookAt(eye, eye + along, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        Frustum frustum(viewProj);
+        occlusion.render(viewProj);
+        rasterSeconds += occlusion.getRasterSeconds();
+
+        for (unsigned int i = 0; i < lows.size(); ++i) {
+            if (!frustum.intersects(lows[i], highs[i])) continue;
+            inFrustum++;
+            if (!occlusion.isVisible(lows[i], highs[i]))
+                occluded++;
+        }
+    }
 
-    // restore
-    glDepthFunc(GL_LESS);
+    std::cout << "Occlusion benchmark: " << views << " views, " << inFrustum << " boxes in the frustum, "
+        << occluded << " occluded (" << (inFrustum > 0 ? occluded * 100 / inFrustum : 0) << "%), "
+        << rasterSeconds * 1000.0 / views << " ms raster per view" << std::endl;
 }
 
 // ----------------------------------------------------
@@ -243,17 +580,243 @@ bool isPlayerNearBeacon(const glm::vec3& playerPosition, const glm::vec3& beacon
     return glm::distance(playerPosition, beaconPosition) <= range;
 }
 
+// Quest item positions
+const glm::vec3 backpackPosition = glm::vec3(200.0f, -13.0f, 242.0f); // Position of the backpack
+const glm::vec3 ghillieSuitPosition = glm::vec3(-280.0f, -20.0f, -200.0f); // Position of the beacon
+const glm::vec3 hiddenMapPosition = glm::vec3(250.0f, -20.0f, 200.0f);  // Random position for the hidden map
+const glm::vec3 beaconPosition = glm::vec3(-260.0f, -20.0f, 170.0f);  // Position for the beacon
+const glm::vec3 keyPosition = glm::vec3(-220.0f, -10.0f, 160.0f);      // Position for the key (near the beacon)
+const glm::vec3 helicopterPosition = glm::vec3(150.0f, 0.0f, -150.0f);
+
+// Shown once the beacon is on
+glm::mat4 helicopterMatrix()
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), helicopterPosition);
+    return glm::scale(model, glm::vec3(0.03f, .03f, .03f)); // Adjust size if needed
+}
+
+// ------------------------------------------------
+// Everything the simulation changes. There are two: the frame being rendered reads one
+// while the next frame's is written into the other, see FramePipeline
+struct GameState {
+    Camera camera;
+    glm::vec3 cameraPosition; // the camera as rendered, Camera's getters are not const
+    glm::mat4 view;
+
+    std::vector<Meteor> meteors;
+    float meteorSpawnTimer;
+
+    float dayNightTime;
+    float cycleAngle;
+    float dayFactor;
+    glm::vec3 lightPos;
+    glm::vec3 ambient;
+
+    glm::vec3 dinoPosition;
+    glm::mat4 dinoModel;
+
+    bool taskDisplayed;
+    bool backpackFound;
+    bool ghillieSuitFound;
+    bool hiddenMapFound;
+    bool keyFound;
+    bool beaconActivated;
+    bool isInvisibleToDino;
+    bool escapeActivated;
+};
+
+// Keys and mouse movement for one simulation step. GLFW input belongs to the main
+// thread, the step may run on another one
+struct InputState {
+    bool forward, back, left, right, fast, jump, use;
+    float yaw, pitch;
+    float deltaTime;
+};
+
+void processKeyboardInput(Camera& camera, const InputState& input);
+
+void sampleInput(InputState& input, float dt)
+{
+    input.forward = window.isPressed(GLFW_KEY_W);
+    input.back = window.isPressed(GLFW_KEY_S);
+    input.left = window.isPressed(GLFW_KEY_A);
+    input.right = window.isPressed(GLFW_KEY_D);
+    input.fast = window.isPressed(GLFW_KEY_LEFT_SHIFT) || window.isPressed(GLFW_KEY_RIGHT_SHIFT);
+    input.jump = window.isPressed(GLFW_KEY_SPACE);
+    input.use = window.isPressed(GLFW_KEY_E);
+
+    input.yaw = mouseYaw;
+    input.pitch = mousePitch;
+    mouseYaw = 0.0f;
+    mousePitch = 0.0f;
+
+    input.deltaTime = dt;
+}
+
+// One simulation step: movement & collisions, meteors, day-night cycle, the dino chase
+// and the quests. Reads only from and input, so it can run next to the renderer
+void simulate(const GameState& from, GameState& state, const InputState& input)
+{
+    state = from;
+    float dt = input.deltaTime;
+
+    // Movement & collisions
+    state.camera.rotateOy(input.yaw);
+    state.camera.rotateOx(input.pitch);
+    processKeyboardInput(state.camera, input);
+    glm::vec3 playerPosition = state.camera.getCameraPosition();
+
+    if (!state.taskDisplayed) {
+        displayCurrentTask();
+        state.taskDisplayed = true; // Mark task as displayed
+    }
+
+    // ------------------------------------------------
+    // Meteors
+    // Example: spawn a meteor every 3s
+    state.meteorSpawnTimer += dt;
+    if (state.meteorSpawnTimer > 3.0f) {
+        spawnMeteor(state.meteors);
+        state.meteorSpawnTimer = 0.0f;
+    }
+
+    // Update meteors
+    updateMeteors(state.meteors, dt);
+
+    // ------------------------------------------------
+    // Day-night cycle
+    state.dayNightTime += dt;
+    if (state.dayNightTime > cycleDuration) {
+        state.dayNightTime -= cycleDuration; // wrap around
+    }
+    float cycleangle = 2.0f * 3.14159f * (state.dayNightTime / cycleDuration);
+
+    // Lets assume the sun is ~200 units away from the origin, and goes around in a big circle
+    float radius = 200.0f;
+    float sunX = radius * cos(cycleangle);
+    float sunZ = radius * sin(cycleangle);
+    // Lets keep the Y somewhat high to mimic overhead sunlight
+    float sunY = 200.0f + 100.0f * sin(cycleangle); // or just pick something like 100 or 150
+
+    state.lightPos = glm::vec3(sunX, sunY, sunZ);
+    state.cycleAngle = cycleangle;
+    state.dayFactor = 0.5f * (1.0f + sin(cycleangle));
+
+    // dayFactor=1 => bright day color
+    // dayFactor=0 => dark night color
+    glm::vec3 dayColor(0.5f, 0.7f, 1.0f);   // bright, slightly bluish
+    glm::vec3 nightColor(0.05f, 0.05f, 0.1f); // near-black, faintly bluish
+
+    state.ambient = glm::mix(nightColor, dayColor, state.dayFactor);
+
+    // ------------------------------------------------
+    // Calculate the direction vector from the T-Rex to the player
+    glm::vec3 flatPlayerPosition = glm::vec3(playerPosition.x, 0.0f, playerPosition.z); // Ignore Y-axis
+    glm::vec3 flatDinoPosition = glm::vec3(state.dinoPosition.x, 0.0f, state.dinoPosition.z); // Ignore Y-axis
+
+    glm::vec3 direction = glm::normalize(flatPlayerPosition - flatDinoPosition); // Normalize the direction vector;
+
+    // Update the T-Rex position
+    float dinoSpeed = 10.0f; // Adjust the speed as needed
+    state.dinoPosition.y = -20.0f; // Ensure the T-Rex stays on the ground
+
+    if (!state.isInvisibleToDino) {
+        state.dinoPosition += direction * dinoSpeed * dt; // Move the T-Rex toward the player
+    }
+
+    // Calculate rotation angle to face the player
+    float angle = atan2(direction.x, direction.z); // Use X and Z components only
+
+    // Update ModelMatrix for the T-Rex
+    state.dinoModel = glm::translate(glm::mat4(1.0f), state.dinoPosition); // Position the T-Rex
+    state.dinoModel = glm::rotate(state.dinoModel, -angle, glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate the T-Rex around the Y-axis
+    state.dinoModel = glm::scale(state.dinoModel, glm::vec3(60.0f, 60.0f, 60.0f)); // Scale the T-Rex
+
+    // --------------------------------------------
+    //backpack
+    if (!state.backpackFound && isPlayerNearBackpack(playerPosition, backpackPosition, 20.0f)) {
+        state.backpackFound = true; // Mark backpack as found
+        std::cout << "You found the backpack!" << std::endl;
+        tasks[0].completed = true;
+        state.taskDisplayed = false;
+    }
+
+    // Task 2: Ghillie Suit
+    if (state.backpackFound && !state.ghillieSuitFound && isPlayerNearGhillieSuit(playerPosition, ghillieSuitPosition, 20.0f)) {
+        state.ghillieSuitFound = true; // Mark the ghillie suit as found
+        state.isInvisibleToDino = true;
+        std::cout << "You found the ghillie suit!" << std::endl; // Print message
+        tasks[1].completed = true; // Mark Task 2 as completed
+        state.taskDisplayed = false;
+    }
+
+    // Task 3: Hidden Map
+    if (state.backpackFound && state.ghillieSuitFound && !state.hiddenMapFound && isPlayerNearHiddenMap(playerPosition, hiddenMapPosition, 20.0f)) {
+        state.hiddenMapFound = true; // Mark the hidden map as found
+        std::cout << "You found the hidden map!" << std::endl; // Print message
+        tasks[2].completed = true; // Mark Task 3 as completed
+        state.taskDisplayed = false;
+    }
+
+    // Task 4: Beacon and Key
+    if (state.hiddenMapFound && !state.keyFound && isPlayerNearKey(playerPosition, keyPosition, 10.0f)) {
+        std::cout << "You found the key!" << std::endl;
+        state.keyFound = true;
+        std::cout << "Press 'E' to pick it up." << std::endl;
+
+        if (input.use) {
+            state.keyFound = true;  // Mark the key as picked up
+            std::cout << "You have picked up the key!" << std::endl;
+        }
+    }
+
+    if (state.keyFound && !state.beaconActivated && isPlayerNearBeacon(playerPosition, beaconPosition, 70.0f)) {
+        if (input.use) { // Player presses 'E' to activate the beacon
+            state.beaconActivated = true; // Beacon activated
+            std::cout << "You activated the power beacon!" << std::endl;
+            std::cout << "Help is on the way!" << std::endl;
+            tasks[3].completed = true; // Mark Task 4 as completed
+            state.taskDisplayed = false;
+        }
+    }
+
+    if (state.hiddenMapFound && !state.keyFound && isPlayerNearKey(playerPosition, keyPosition, 10.0f)) {
+        state.keyFound = true;  // Mark the key as found automatically
+        std::cout << "You found the key!" << std::endl;
+        std::cout << "The key has been picked up!" << std::endl; // No need for 'E', it's automatic
+    }
+
+    if (state.beaconActivated && !state.escapeActivated && isPlayerNearBeacon(playerPosition, helicopterPosition, 70.0f)) {
+        if (input.use) {
+            state.escapeActivated = true;  // Mark escape as triggered
+            std::cout << "Good job, you escaped!" << std::endl;  // Print message in the console
+        }
+    }
+
+    state.cameraPosition = playerPosition;
+    state.view = state.camera.getViewMatrix();
+}
+
 // MAIN
 int main()
 {
     glClearColor(0.2f, 0.8f, 1.0f, 1.0f);
 
-    camera.setCameraPosition(glm::vec3(0.0f, -20.0f + 14.0f, 0.0f)); // start pos
-
     // Build and compile shader programs
-    Shader shader("Shaders/vertex_shader.glsl", "Shaders/fragment_shader.glsl");
+    // Lit objects share one source, variants are built in the background when first used
+    ShaderLibrary litShaders("Shaders/vertex_shader.glsl", "Shaders/fragment_shader.glsl");
+    litShaders.setWorkerContext(window.createSharedContext());
+    Shader& shader = litShaders.get(0);
+
+    // Distant objects get cheaper lighting variants
+    ShaderLod shaderLod;
+    // the crossfades of every lighting level are built right away, not at the first fade
+    for (int level = 0; level < SHADER_LOD_LEVELS; ++level)
+        litShaders.get(ShaderLod::getFeatures(level) | SHADER_LOD_DITHER);
+    // and simplified geometry, coarser while frames take longer than 1/60 s
+    LodSelector lodSelector;
+
     Shader sunShader("Shaders/sun_vertex_shader.glsl", "Shaders/sun_fragment_shader.glsl");
-    Shader meteorShader("Shaders/meteor_vertex_shader.glsl", "Shaders/meteor_fragment_shader.glsl");
 
     // Load textures
     GLuint tex = loadBMP("Resources/Textures/wood.bmp");
@@ -275,7 +838,14 @@ int main()
     glfwSetCursorPosCallback(window.getWindow(), cursor_position_callback);
     glfwSetInputMode(window.getWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    glEnable(GL_DEPTH_TEST);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+
+    // Uniforms, streamed instances and indirect commands are written into persistently mapped rings,
+    // there is no other path for them. Returning lets the window terminate GLFW
+    if (!RingBuffer::isSupported()) {
+        std::cout << "Persistently mapped buffers need GL 4.4 or ARB_buffer_storage, exiting" << std::endl;
+        return -1;
+    }
 
     // Mesh loading
     std::vector<Vertex> vert;
@@ -325,11 +895,12 @@ int main()
     Mesh sun = loader.loadObj("Resources/Models/sphere.obj");
     Mesh box = loader.loadObj("Resources/Models/cube.obj", textures);
     Mesh plane = loader.loadObj("Resources/Models/plane.obj", textures3_);
-    Mesh tree_trunk = loader.loadObj("Resources/Models/tree_trunk.obj");
-    Mesh tree_crown = loader.loadObj("Resources/Models/tree_crown.obj");
-    Mesh walls = loader.loadObj("Resources/Models/cubewall.obj");
-    Mesh rock = loader.loadObj("Resources/Models/planerock.obj");
-    Mesh dino = loader.loadObj("Resources/Models/dino.obj");
+    // static batching reads the vertices of these, they drop them afterwards
+    Mesh tree_trunk = loader.loadObj("Resources/Models/tree_trunk.obj", MESH_RESIDENCY_FULL);
+    Mesh tree_crown = loader.loadObj("Resources/Models/tree_crown.obj", MESH_RESIDENCY_FULL);
+    Mesh walls = loader.loadObj("Resources/Models/cubewall.obj", MESH_RESIDENCY_FULL);
+    Mesh rock = loader.loadObj("Resources/Models/planerock.obj", MESH_RESIDENCY_FULL);
+    Mesh dino = loader.loadObj("Resources/Models/dino.obj", MESH_RESIDENCY_FULL);
     Mesh meteorMesh = loader.loadObj("Resources/Models/meteor.obj");
     Mesh skySphere = loader.loadObj("Resources/Models/sphere_inward.obj");
     Mesh backpack = loader.loadObj("Resources/Models/backpack.obj");
@@ -337,7 +908,7 @@ int main()
     Mesh ghillieSuitMesh = loader.loadObj("Resources/Models/uniform1.obj");
     Mesh hiddenmap = loader.loadObj("Resources/Models/box.obj");
     Mesh key = loader.loadObj("Resources/Models/Key9.obj", textures2_);
-    Mesh helicopter = loader.loadObj("Resources/Models/Lowpoly_Helicopter.obj", textures2_);
+    Mesh helicopter = loader.loadObj("Resources/Models/Lowpoly_Helicopter.obj", textures2_, MESH_RESIDENCY_FULL);
 
 
     std::vector<Texture> skySphereTextures;
@@ -357,8 +928,33 @@ int main()
     meteorTextures.push_back(Texture{ meteorTex, "texture_diffuse" });
     meteorMesh.setTextures(meteorTextures);
 
-    // Dino start
-    glm::vec3 dinoPosition = glm::vec3(200.0f, -20.0f, 200.0f);
+    std::vector<Texture> dinoTextures;
+    dinoTextures.push_back(Texture{ dinoTexture, "texture_diffuse" });
+    dino.setTextures(dinoTextures);
+
+    // Simplified copies for the distance, the sources only keep what the build needs
+    MeshLod dinoLod, helicopterLod;
+    dinoLod.build(dino);
+    helicopterLod.build(helicopter);
+    dino.setResidency(Mesh::defaultResidency);
+    helicopter.setResidency(Mesh::defaultResidency);
+    LodState dinoLodState, helicopterLodState;
+
+    std::vector<Texture> rockTextures;
+    rockTextures.push_back(Texture{ tex4, "texture_diffuse" });
+    rock.setTextures(rockTextures);
+
+    std::vector<Texture> wallTextures;
+    wallTextures.push_back(Texture{ tex4, "texture_diffuse" });
+    walls.setTextures(wallTextures);
+
+    // Uniform blocks shared by all shaders, a new ring range every frame
+    UniformBuffer frameUniforms;
+    frameUniforms.create(sizeof(FrameUniforms), FRAME_BLOCK_BINDING);
+
+    UniformStream objectUniforms;
+    objectUniforms.create(256 * 1024, OBJECT_BLOCK_BINDING);
+
     glm::mat4 ModelMatrix = glm::mat4(1.0f);
 
     // Define positions for 20 trees
@@ -422,428 +1018,450 @@ int main()
         sceneObjects.push_back(so);
     }
 
-    // Spawn a new meteor every 3s
-    float meteorSpawnTimer = 0.0f;
-
-
-    glm::vec3 backpackPosition = glm::vec3(200.0f, -13.0f, 242.0f); // Position of the backpack
-    bool backpackFound = false;
-
-    glm::vec3 ghillieSuitPosition = glm::vec3(-280.0f, -20.0f, -200.0f); // Position of the beacon
-    bool ghillieSuitFound = false;  // To track whether the ghillie suit has been found
-
-    glm::vec3 hiddenMapPosition = glm::vec3(250.0f, -20.0f, 200.0f);  // Random position for the hidden map
-    bool hiddenMapFound = false;
-
-    glm::vec3 beaconPosition = glm::vec3(-260.0f, -20.0f, 170.0f);  // Position for the beacon
-    glm::vec3 keyPosition = glm::vec3(-220.0f, -10.0f, 160.0f);      // Position for the key (near the beacon)
-    bool keyFound = false; // Track if the key has been picked up
-    bool beaconActivated = false;  // Track if the beacon is activated
-
-    glm::vec3 helicopterPosition = glm::vec3(150.0f, 0.0f, -150.0f);
-
-    bool taskDisplayed = false;
-    bool isInvisibleToDino = false;
-    bool escapeActivated = false;
+    // ------------------------------------------------
+    // Trees, rocks and the wall never move: they are pre-transformed once into
+    // one merged mesh per material and 256 unit cell, culled per cell
+    std::vector<glm::mat4> treeMatrices;
+    std::vector<glm::mat4> crownMatrices;
+    for (int i = 0; i < 20; ++i) {
+        treeMatrices.push_back(treeTrunkMatrix(treePositions[i]));
+        crownMatrices.push_back(treeCrownMatrix(treePositions[i]));
+    }
+    std::vector<glm::mat4> rockMatrices;
+    for (int i = 0; i < 12; ++i) {
+        glm::mat4 rockMatrix = glm::translate(glm::mat4(1.0f), rockPositions[i]);
+        rockMatrices.push_back(glm::scale(rockMatrix, glm::vec3(0.2f)));
+    }
+    glm::mat4 wallMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(-40.0f, -10.0f, 40.0f));
+    wallMatrix = glm::scale(wallMatrix, glm::vec3(25.0f, 30.0f, 25.0f));
+
+    // The play area is about 700 units across, so the far cells are some 250-550 units
+    // away from the other side of it: there they drop to their proxies. The wall's cell
+    // encloses the play area, the camera is always inside its box and it keeps its batches
+    StaticBatcher sceneryBatches(256.0f);
+    sceneryBatches.proxyDistance = 300.0f;
+    sceneryBatches.add(tree_trunk, treeMatrices.data(), 20);
+    sceneryBatches.add(tree_crown, crownMatrices.data(), 20);
+    sceneryBatches.add(rock, rockMatrices.data(), 12);
+    sceneryBatches.add(walls, &wallMatrix, 1);
+    sceneryBatches.build();
+
+    // The wall and the big rocks hide what is behind them, their largest triangles are
+    // rasterized on the CPU every frame and the boxes of the other objects tested against it
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    OcclusionCuller occlusion(256, 144, hardwareThreads > 1 ? glm::min(hardwareThreads - 1, 3u) : 0);
+    for (int i = 0; i < 12; ++i)
+        occlusion.addOccluder(rock, rockMatrices[i], 256);
+    occlusion.addOccluder(walls, wallMatrix, 2048);
+    bool occlusionBenchmarkKeyDown = false;
+
+    // the forest below still draws trunks and crowns from the arena, not from these copies
+    tree_trunk.setResidency(Mesh::defaultResidency);
+    tree_crown.setResidency(Mesh::defaultResidency);
+    rock.setResidency(Mesh::defaultResidency);
+    walls.setResidency(Mesh::defaultResidency);
+
+    // The sun's shadows: the scenery batches are cached per cascade and only redrawn when the
+    // sun has turned far enough, the dino, meteors and helicopter go on top every frame.
+    // F7 turns the cache off to compare the cost
+    ShadowCascades sunShadows;
+    const float shadowSplits[SHADOW_CASCADES] = { 40.0f, 150.0f, 500.0f };
+    sunShadows.create(shadowSplits);
+    sunShadows.setStaticCasters(&sceneryBatches);
+    bool shadowCacheKeyDown = false;
+
+    std::vector<StaticBatch*> visibleBatches;
+    std::vector<const HlodCluster*> visibleProxies;
+
+    RenderQueue renderQueue;
+
+    // With GL 4.3 the forest and the meteors are multi-draws over object records,
+    // the instanced draws are the fallback
+    bool useIndirect = IndirectRenderer::isSupported();
+    IndirectRenderer indirect;
+    unsigned int forestRecords = 0;
+    if (useIndirect)
+        indirect.create(64, 256);
+
+    // F4 adds a 10,000 tree benchmark forest, built on first use
+    const int forestSize = 10000;
+    std::vector<glm::vec3> forestPositions;
+    std::vector<InstanceData> forestInstanceData;
+    std::vector<int> forestProxies;
+    std::vector<glm::vec3> forestLows, forestHighs;
+    std::vector<unsigned int> visibleForest;
+    InstanceBuffer forestInstances;
+    bool forestEnabled = false;
+    bool forestKeyDown = false;
+
+    // Forest trees past treeImpostorDistance are one quad each, from views baked here
+    Impostor treeImpostor;
+    const Mesh* treeParts[2] = { &tree_trunk, &tree_crown };
+    glm::mat4 treePartModels[2] = { treeTrunkMatrix(glm::vec3(0.0f)), treeCrownMatrix(glm::vec3(0.0f)) };
+    treeImpostor.bake(treeParts, treePartModels, 2);
+    const float treeImpostorDistance = 250.0f;
+    InstanceBuffer treeImpostorInstances;
+    treeImpostorInstances.create(forestSize, true);
+    std::vector<InstanceData> forestImpostorData;
+    std::vector<unsigned int> impostorTrees;
+
+    // The forest is recorded on every core into one packet list per thread, the GL
+    // calls stay on this thread
+    JobPool jobs(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+    std::vector<CommandList> forestCommands(jobs.getThreadCount());
+    std::vector<ShaderLod> threadShaderLods(jobs.getThreadCount());
+    std::vector<unsigned int> threadTested(jobs.getThreadCount()), threadOccluded(jobs.getThreadCount());
+
+    // Meteors move every frame, their instances are streamed
+    InstanceBuffer meteorInstances;
+    meteorInstances.create(64, true);
+    std::vector<const Meteor*> visibleMeteors;
+
+    // Forest trees, meteors and the dino, culled hierarchically once per frame
+    BoundsTree sceneTree;
+    std::vector<unsigned int> visibleScene;
+    SceneQuery sceneQuery;
+    int dinoProxy = BOUNDS_TREE_NULL;
+    bool dinoVisible = true;
+
+    std::vector<int> meteorProxies;
 
     float beaconCollisionRadius = 8.f;
     float helicopterCollisionRadius = 12.f;
 
+    bool lodReportKeyDown = false;
+    bool cullingScalingKeyDown = false;
+    bool cullingScalingRequested = false;
+
+    // ------------------------------------------------
+    // Game state, simulated one frame ahead of the renderer in throughput mode. F6
+    // switches to latency mode, which simulates right before rendering instead
+    GameState states[2];
+    states[0].camera.setCameraPosition(glm::vec3(0.0f, -20.0f + 14.0f, 0.0f)); // start pos
+    states[0].meteorSpawnTimer = 0.0f; // Spawn a new meteor every 3s
+    states[0].dayNightTime = 0.0f;
+    states[0].cycleAngle = 0.0f;
+    states[0].dayFactor = 0.5f;
+    states[0].lightPos = glm::vec3(30.0f, 180.0f, 50.0f);
+    states[0].ambient = glm::vec3(0.2f, 0.8f, 1.0f);
+    states[0].dinoPosition = glm::vec3(200.0f, -20.0f, 200.0f); // Dino start
+    states[0].dinoModel = glm::translate(glm::mat4(1.0f), states[0].dinoPosition);
+    states[0].taskDisplayed = false;
+    states[0].backpackFound = false;
+    states[0].ghillieSuitFound = false;  // To track whether the ghillie suit has been found
+    states[0].hiddenMapFound = false;
+    states[0].keyFound = false; // Track if the key has been picked up
+    states[0].beaconActivated = false;  // Track if the beacon is activated
+    states[0].isInvisibleToDino = false;
+    states[0].escapeActivated = false;
+    states[0].cameraPosition = states[0].camera.getCameraPosition();
+    states[0].view = states[0].camera.getViewMatrix();
+    states[1] = states[0];
+
+    InputState inputs[2];
+    FramePipeline pipeline([&](unsigned int from, unsigned int to) {
+        simulate(states[from], states[to], inputs[to]);
+    }, FRAME_PIPELINE_THROUGHPUT);
+    bool pipelineKeyDown = false;
+
     // ------------------------------------------------
     // Main loop
     while (!window.isPressed(GLFW_KEY_ESCAPE) &&
         !glfwWindowShouldClose(window.getWindow()))
     {  
+        // waits only if the GPU is RING_FRAMES frames behind
+        RingBuffer::beginFrame();
+        GLState::beginFrame();
+        CullingSet::beginFrame();
+
         window.clear();
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        glm::mat4 projection = glm::perspective(
-            glm::radians(90.0f),
-            (float)window.getWidth() / (float)window.getHeight(),
-            0.1f,
-            10000.0f
-        );
-
-        // Draw the sky sphere
-        drawSkySphere(skySphere, shader, camera.getCameraPosition(), projection);
-        shader.use();
-
-        // Normal camera-based
-        glm::mat4 view = glm::lookAt(
-            camera.getCameraPosition(),
-            camera.getCameraPosition() + camera.getCameraViewDirection(),
-            camera.getCameraUp()
-        );
-
-        // Movement & collisions
-        processKeyboardInput();
+        litShaders.update();
 
-        if (!taskDisplayed) {
-            displayCurrentTask();
-            taskDisplayed = true; // Mark task as displayed
-        }
+        // This frame's input goes to the next simulation step, the state to render is the
+        // newest finished one
+        sampleInput(inputs[pipeline.getInputSlot()], deltaTime);
+        const GameState& state = states[pipeline.beginFrame()];
+        glm::vec3 eye = state.cameraPosition;
 
         // Example mouse usage
         if (window.isMousePressed(GLFW_MOUSE_BUTTON_LEFT)) {
             std::cout << "Pressing mouse button" << std::endl;
         }
 
-        // ------------------------------------------------
-        // Meteors
-        // Example: spawn a meteor every 3s
-        meteorSpawnTimer += deltaTime;
-        if (meteorSpawnTimer > 3.0f) {
-            spawnMeteor();
-            meteorSpawnTimer = 0.0f;
-        }
-
-        // Update meteors
-        updateMeteors(deltaTime);
+        // You can also change glClearColor if you want the background to change
+        glClearColor(state.ambient.r, state.ambient.g, state.ambient.b, 1.0f);
 
         // ------------------------------------------------
-        // Day-night cycle
-        dayNightTime += deltaTime;
-        if (dayNightTime > cycleDuration) {
-            dayNightTime -= cycleDuration; // wrap around
+        // Sun shadows, the sun orbits the origin so it shines from lightPos towards it
+        sunShadows.addDynamic(dino, state.dinoModel);
+        for (const Meteor& m : state.meteors) {
+            if (m.active)
+                sunShadows.addDynamic(meteorMesh, meteorMatrix(m));
         }
-        float cycleangle = 2.0f * 3.14159f * (dayNightTime / cycleDuration);
-
-        // Lets assume the sun is ~200 units away from the origin, and goes around in a big circle
-        float radius = 200.0f;
-        float sunX = radius * cos(cycleangle);
-        float sunZ = radius * sin(cycleangle);
-        // Lets keep the Y somewhat high to mimic overhead sunlight
-        float sunY = 200.0f + 100.0f * sin(cycleangle); // or just pick something like 100 or 150
-
-        lightPos = glm::vec3(sunX, sunY, sunZ);
-
-        float dayFactor = 0.5f * (1.0f + sin(cycleangle));
-
-        // dayFactor=1 => bright day color
-        // dayFactor=0 => dark night color
-        glm::vec3 dayColor(0.5f, 0.7f, 1.0f);   // bright, slightly bluish
-        glm::vec3 nightColor(0.05f, 0.05f, 0.1f); // near-black, faintly bluish
-
-        glm::vec3 currentAmbient = glm::mix(nightColor, dayColor, dayFactor);
-
-        // You can also change glClearColor if you want the background to change
-        glClearColor(currentAmbient.r, currentAmbient.g, currentAmbient.b, 1.0f);
+        if (state.beaconActivated)
+            sunShadows.addDynamic(helicopter, helicopterMatrix());
+        sunShadows.render(eye, glm::normalize(state.lightPos));
+        sunShadows.bind();
 
         // ------------------------------------------------
-        // Light
-        sunShader.use();
-
+        // Per-frame uniforms, written once and shared by every shader
         glm::mat4 ProjectionMatrix = glm::perspective(
             90.0f,
             (float)window.getWidth() / (float)window.getHeight(),
             0.1f,
             10000.0f
         );
-        glm::mat4 ViewMatrix = glm::lookAt(
-            camera.getCameraPosition(),
-            camera.getCameraPosition() + camera.getCameraViewDirection(),
-            camera.getCameraUp()
-        );
+        glm::mat4 ViewMatrix = state.view;
 
-        GLuint MatrixID = glGetUniformLocation(sunShader.getId(), "MVP");
+        FrameUniforms frame;
+        frame.view = ViewMatrix;
+        frame.projection = ProjectionMatrix;
+        frame.viewProj = ProjectionMatrix * ViewMatrix;
+        frame.lightPos = glm::vec4(state.lightPos, 1.0f);
+        frame.lightColor = glm::vec4(lightColor, 1.0f);
+        frame.viewPos = glm::vec4(eye, 1.0f);
+        frame.time = glm::vec4(currentFrame, state.dayFactor, state.cycleAngle, deltaTime);
+        frame.fogColor = glm::vec4(state.ambient, 0.0015f);
+        sunShadows.fillUniforms(frame);
+        frameUniforms.update(&frame, sizeof(frame));
 
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, lightPos);
-        glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
+        // Everything below is culled against the planes of projection * view
+        Frustum viewFrustum(frame.viewProj);
 
-        sun.draw(sunShader);
+        shaderLod.beginFrame(ProjectionMatrix, window.getWidth(), window.getHeight(), eye);
+        lodSelector.beginFrame(ProjectionMatrix, window.getHeight(), eye, deltaTime);
 
-        // ------------------------------------------------
-        // Scene shader
-        shader.use();
+        if (useIndirect)
+            indirect.begin();
+
+        // Single objects are queued and drawn sorted once everything is submitted
+        renderQueue.begin(eye, 10000.0f, viewFrustum);
 
-        GLuint MatrixID2 = glGetUniformLocation(shader.getId(), "MVP");
-        GLuint ModelMatrixID = glGetUniformLocation(shader.getId(), "model");
+        // Sky sphere
+        renderQueue.submit(RENDER_PASS_SKY, shader, skySphere, skySphereMatrix(eye));
 
-        // Example box at origin
+        // ------------------------------------------------
+        // Light
         ModelMatrix = glm::mat4(1.0f);
-        MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-        glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-        glUniform3f(glGetUniformLocation(shader.getId(), "lightColor"),
-            lightColor.x, lightColor.y, lightColor.z);
-        glUniform3f(glGetUniformLocation(shader.getId(), "lightPos"),
-            lightPos.x, lightPos.y, lightPos.z);
-        glUniform3f(glGetUniformLocation(shader.getId(), "viewPos"),
-            camera.getCameraPosition().x,
-            camera.getCameraPosition().y,
-            camera.getCameraPosition().z);
+        ModelMatrix = glm::translate(ModelMatrix, state.lightPos);
+        renderQueue.submit(RENDER_PASS_OPAQUE, sunShader, sun, ModelMatrix);
 
         // Plane (the ground)
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, -20.0f, 0.0f));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5.0f, 1.0f, 7.0f));
-        MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-        glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-        plane.draw(shader);
-
-        // ------------------------------------------------
-        // Calculate the direction vector from the T-Rex to the player
-        glm::vec3 playerPosition = camera.getCameraPosition(); // Get player's current position
-        glm::vec3 flatPlayerPosition = glm::vec3(playerPosition.x, 0.0f, playerPosition.z); // Ignore Y-axis
-        glm::vec3 flatDinoPosition = glm::vec3(dinoPosition.x, 0.0f, dinoPosition.z); // Ignore Y-axis
-
-        glm::vec3 direction = glm::normalize(flatPlayerPosition - flatDinoPosition); // Normalize the direction vector;
+        renderQueue.submit(RENDER_PASS_OPAQUE, shader, plane, ModelMatrix);
 
-        // Update the T-Rex position
-        float dinoSpeed = 10.0f; // Adjust the speed as needed
-        dinoPosition.y = -20.0f; // Ensure the T-Rex stays on the ground
+        // The T-Rex, moved by the simulation
+        ModelMatrix = state.dinoModel;
 
-        if (!isInvisibleToDino) {
-            dinoPosition += direction * dinoSpeed * deltaTime; // Move the T-Rex toward the player
+        // ------------------------------------------------
+        // Everything in the scene tree has moved, cull it and split the result by kind
+        glm::vec3 dinoCenter, dinoExtent;
+        float dinoRadius;
+        CullingSet::transform(dino, ModelMatrix, dinoCenter, dinoExtent, dinoRadius);
+        if (dinoProxy == BOUNDS_TREE_NULL)
+            dinoProxy = sceneTree.insert(dinoCenter - dinoExtent, dinoCenter + dinoExtent, SCENE_DINO, sceneTreeMargin);
+        else
+            sceneTree.update(dinoProxy, dinoCenter - dinoExtent, dinoCenter + dinoExtent, sceneTreeMargin);
+        trackMeteors(sceneTree, meteorMesh, state.meteors, meteorProxies);
+
+        queryScene(jobs, sceneTree, viewFrustum, sceneQuery, visibleScene);
+        visibleForest.clear();
+        visibleMeteors.clear();
+        dinoVisible = false;
+        for (unsigned int data : visibleScene) {
+            unsigned int kind = data & SCENE_KIND;
+            if (kind == SCENE_FOREST)
+                visibleForest.push_back(data);
+            else if (kind == SCENE_METEOR)
+                visibleMeteors.push_back(&state.meteors[data & ~SCENE_KIND]);
+            else if (kind == SCENE_DINO)
+                dinoVisible = true;
+        }
+        // the forest draws expect trunks before crowns
+        std::sort(visibleForest.begin(), visibleForest.end());
+
+        // What survived the frustum is tested against the occluders
+        occlusion.render(frame.viewProj);
+
+        // Worker threads take slices of the visible forest: occlusion, impostor distance and
+        // lighting level, recorded as packets. Far trees become one impostor each
+        ForestFrame forest;
+        if (forestEnabled) {
+            forest.visible = &visibleForest;
+            forest.positions = forestPositions.data();
+            forest.lows = forestLows.data();
+            forest.highs = forestHighs.data();
+            forest.count = forestSize;
+            forest.cameraPos = eye;
+            forest.impostorDistance = treeImpostor.isBaked() ? treeImpostorDistance : 0.0f;
+            forest.treeRadius = tree_crown.boundingRadius * 5.0f;
+            forest.treeVertices = tree_trunk.vertexCount + tree_crown.vertexCount;
+            forest.occlusion = &occlusion;
+
+            for (unsigned int t = 0; t < jobs.getThreadCount(); ++t) {
+                forestCommands[t].clear();
+                threadShaderLods[t] = shaderLod.fork();
+                threadTested[t] = 0;
+                threadOccluded[t] = 0;
+            }
+            jobs.run(visibleForest.size(), [&](unsigned int thread, unsigned int begin, unsigned int end) {
+                recordTrees(forest, begin, end, threadShaderLods[thread], forestCommands[thread],
+                    threadTested[thread], threadOccluded[thread]);
+            });
+            for (unsigned int t = 0; t < jobs.getThreadCount(); ++t) {
+                shaderLod.merge(threadShaderLods[t]);
+                occlusion.addCounts(threadTested[t], threadOccluded[t]);
+            }
         }
 
-        // Calculate rotation angle to face the player
-        float angle = atan2(direction.x, direction.z); // Use X and Z components only
-
-        // Update ModelMatrix for the T-Rex
-        ModelMatrix = glm::translate(glm::mat4(1.0f), dinoPosition); // Position the T-Rex
-        ModelMatrix = glm::rotate(ModelMatrix, -angle, glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate the T-Rex around the Y-axis
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(60.0f, 60.0f, 60.0f)); // Scale the T-Rex
-        MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
+        if (cullingScalingRequested) {
+            runCullingScaling(jobs, sceneTree, viewFrustum, sceneQuery, forestEnabled ? &forest : NULL, shaderLod);
+            cullingScalingRequested = false;
+        }
 
-        // Assign texture to the T-Rex
-        std::vector<Texture> dinoTextures;
-        dinoTextures.push_back(Texture{ dinoTexture, "texture_diffuse" });
-        dino.setTextures(dinoTextures);
+        unsigned int meteorsKept = 0;
+        for (const Meteor* m : visibleMeteors) {
+            glm::vec3 center, extent;
+            float radius;
+            CullingSet::transform(meteorMesh, meteorMatrix(*m), center, extent, radius);
+            if (occlusion.isVisible(center - extent, center + extent))
+                visibleMeteors[meteorsKept++] = m;
+        }
+        visibleMeteors.resize(meteorsKept);
 
-        // Update shader uniforms
-        glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
+        if (dinoVisible)
+            dinoVisible = occlusion.isVisible(dinoCenter - dinoExtent, dinoCenter + dinoExtent);
 
         // Draw the T-Rex
-        dino.draw(shader);
-
-        // ------------------------------------------------
-        // Draw all trees
-        for (int i = 0; i < 20; ++i) {
-            glm::vec3 position = treePositions[i];
-
-            // trunk
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, position);
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5.0f));
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-            glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-            tree_trunk.draw(shader);
-
-            // crown
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, position + glm::vec3(0.0f, -4.0f, 0.0f));
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5.0f));
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-            glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-            tree_crown.draw(shader);
+        if (dinoVisible) {
+            unsigned int dinoFeatures = shaderLod.select(state.dinoPosition, dino.boundingRadius * 60.0f, dino.vertexCount);
+            lodSelector.select(dinoLodState, dinoLod, dinoCenter, dinoRadius, 60.0f);
+            submitLod(renderQueue, litShaders, dinoFeatures, dino, dinoLod, dinoLodState, ModelMatrix, state.dinoPosition);
         }
 
         // ------------------------------------------------
-        // Draw rocks
-        std::vector<Texture> rockTextures;
-        rockTextures.push_back(Texture{ tex4, "texture_diffuse" });
-        rock.setTextures(rockTextures);
+        // Static scenery: the batches are already in world space, far cells are one HLOD proxy each
+        sceneryBatches.cull(viewFrustum, eye, visibleBatches, visibleProxies);
+        for (StaticBatch* batch : visibleBatches) {
+            if (!occlusion.isVisible(batch->low, batch->high)) continue;
+
+            unsigned int batchFeatures = shaderLod.select(batch->center, batch->radius, batch->mesh.vertexCount);
+            lodSelector.select(batch->lodState, batch->lod, batch->center, batch->radius, 1.0f);
+            submitLod(renderQueue, litShaders, batchFeatures, batch->mesh, batch->lod, batch->lodState,
+                glm::mat4(1.0f), batch->center);
+        }
+        for (const HlodCluster* cluster : visibleProxies) {
+            if (!occlusion.isVisible(cluster->low, cluster->high)) continue;
 
-        for (int i = 0; i < 12; ++i) {
-            glm::vec3 position = rockPositions[i];
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, position);
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.2f));
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-            glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-            rock.draw(shader);
+            Shader& proxyShader = litShaders.get(shaderLod.select(cluster->center, cluster->radius,
+                cluster->proxy.vertexCount));
+            renderQueue.submit(RENDER_PASS_OPAQUE, proxyShader, cluster->proxy, glm::mat4(1.0f), cluster->center);
         }
 
         // ------------------------------------------------
-        // Draw walls
-        std::vector<Texture> wallTextures;
-        wallTextures.push_back(Texture{ tex4, "texture_diffuse" });
-        walls.setTextures(wallTextures);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-40.0f, -10.0f, 40.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(25.0f, 30.0f, 25.0f));
-        MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-        glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-        walls.draw(shader);
-
-        // -----------------------------------------------
-        meteorShader.use();
-        // Draw meteors
-        glUniform3f(glGetUniformLocation(meteorShader.getId(), "viewPos"),
-            camera.getCameraPosition().x,
-            camera.getCameraPosition().y,
-            camera.getCameraPosition().z);
-        glUniform3f(glGetUniformLocation(meteorShader.getId(), "lightPos"),
-            lightPos.x, lightPos.y, lightPos.z);
-        glUniform3f(glGetUniformLocation(meteorShader.getId(), "lightColor"),
-            lightColor.x, lightColor.y, lightColor.z);
-        drawMeteors(meteorShader, meteorMesh,
-            ProjectionMatrix, ViewMatrix,
-            MatrixID2, ModelMatrixID);
-
-        // --------------------------------------------
-        //backpack
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, backpackPosition);
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(2.0f, 2.0f, 2.0f)); // Adjust size if needed
-        MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
+        // Benchmark forest and meteors, drawn right away as multi-draws or instanced draws.
+        // The forest packets are replayed here, in thread order
+        impostorTrees.clear();
+        if (useIndirect) {
+            // one multi-draw pass per lighting level
+            if (forestEnabled)
+                replayTreesIndirect(indirect, forestCommands, forestRecords, tree_trunk, tree_crown, impostorTrees);
+
+            queueMeteors(indirect, shaderLod, meteorMesh, visibleMeteors);
+
+            for (int level = 0; level < SHADER_LOD_LEVELS; ++level) {
+                Shader& passShader = litShaders.get(SHADER_INDIRECT | ShaderLod::getFeatures(level));
+                passShader.use();
+                indirect.submit(level, passShader);
+            }
+        }
+        else {
+            // one instanced draw for the trunks and one for the crowns
+            if (forestEnabled) {
+                replayTreesInstanced(litShaders, forestInstances, forestInstanceData, forestCommands,
+                    tree_trunk, tree_crown, impostorTrees);
+            }
 
-        glm::vec3 playerPosition1 = camera.getCameraPosition(); // Get player's current position
+            drawMeteors(litShaders, shaderLod, meteorMesh, meteorInstances, visibleMeteors);
+        }
 
-        if (!backpackFound && isPlayerNearBackpack(camera.getCameraPosition(), backpackPosition, 20.0f)) {
-            backpackFound = true; // Mark backpack as found
-            std::cout << "You found the backpack!" << std::endl;
-            tasks[0].completed = true;
-            taskDisplayed = false;
+        if (!impostorTrees.empty()) {
+            treeImpostorInstances.begin(impostorTrees.size());
+            for (unsigned int tree : impostorTrees)
+                treeImpostorInstances.add(forestImpostorData[tree]);
+            treeImpostor.draw(treeImpostorInstances, 0, impostorTrees.size());
         }
 
+        // --------------------------------------------
+        // Quest items, found and activated by the simulation
         // Render the backpack if it hasnt been found
-        if (!backpackFound) {
+        if (!state.backpackFound) {
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, backpackPosition);
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(2.0f, 2.0f, 2.0f)); // Adjust size if needed
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-            glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-            backpack.draw(shader); // Render the backpack
-        }
 
-        // Task 2: Ghillie Suit
-        if (backpackFound && !ghillieSuitFound && isPlayerNearGhillieSuit(camera.getCameraPosition(), ghillieSuitPosition, 20.0f)) {
-            ghillieSuitFound = true; // Mark the ghillie suit as found
-            isInvisibleToDino = true;
-            std::cout << "You found the ghillie suit!" << std::endl; // Print message
-            tasks[1].completed = true; // Mark Task 2 as completed
-            taskDisplayed = false;
+            renderQueue.submit(RENDER_PASS_OPAQUE, shader, backpack, ModelMatrix); // Render the backpack
         }
 
         // Render the ghillie suit if it hasn't been found
-        if (!ghillieSuitFound && backpackFound) {
+        if (!state.ghillieSuitFound && state.backpackFound) {
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, ghillieSuitPosition);
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(2.0f, 2.0f, 2.0f)); // Adjust size if needed
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
 
             // Draw the ghillie suit with the texture applied
-            ghillieSuitMesh.draw(shader);
-        }
-
-        // Task 3: Hidden Map
-        if (backpackFound && ghillieSuitFound && !hiddenMapFound && isPlayerNearHiddenMap(camera.getCameraPosition(), hiddenMapPosition, 20.0f)) {
-            hiddenMapFound = true; // Mark the hidden map as found
-            std::cout << "You found the hidden map!" << std::endl; // Print message
-            tasks[2].completed = true; // Mark Task 3 as completed
-            taskDisplayed = false;
+            renderQueue.submit(RENDER_PASS_OPAQUE, shader, ghillieSuitMesh, ModelMatrix);
         }
 
         // Render the hidden map if it hasn't been found
-        if (!hiddenMapFound && backpackFound && ghillieSuitFound) {
+        if (!state.hiddenMapFound && state.backpackFound && state.ghillieSuitFound) {
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, hiddenMapPosition);
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(2.0f, 2.0f, 2.0f)); // Adjust size if needed
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
 
             // Draw the hidden map (box.obj)
-            hiddenmap.draw(shader);
-        }
-
-        // Task 4: Beacon and Key
-        if (hiddenMapFound && !keyFound && isPlayerNearKey(camera.getCameraPosition(), keyPosition, 10.0f)) {
-            std::cout << "You found the key!" << std::endl;
-            keyFound = true;
-            std::cout << "Press 'E' to pick it up." << std::endl;
-
-            if (window.isPressed(GLFW_KEY_E)) {
-                keyFound = true;  // Mark the key as picked up
-                std::cout << "You have picked up the key!" << std::endl;
-            }
+            renderQueue.submit(RENDER_PASS_OPAQUE, shader, hiddenmap, ModelMatrix);
         }
 
         // Render the beacon (always visible)
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, beaconPosition);
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(.4f, .4f, .4f)); // Adjust size if needed
-        MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
 
-        beacon.draw(shader); // Always draw the beacon
+        renderQueue.submit(RENDER_PASS_OPAQUE, shader, beacon, ModelMatrix); // Always draw the beacon
 
         // Render the key if the player has completed Task 3 (Hidden Map)
-        if (hiddenMapFound && !keyFound) {
+        if (state.hiddenMapFound && !state.keyFound) {
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, keyPosition);
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(6.0f, 6.0f, 6.0f)); // Adjust size if needed
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-            key.draw(shader); // Render the key (only visible after Hidden Map is found)
-        }
-
-        if (keyFound && !beaconActivated && isPlayerNearBeacon(camera.getCameraPosition(), beaconPosition, 70.0f)) {
-            if (window.isPressed(GLFW_KEY_E)) { // Player presses 'E' to activate the beacon
-                beaconActivated = true; // Beacon activated
-                std::cout << "You activated the power beacon!" << std::endl;
-                std::cout << "Help is on the way!" << std::endl;
-                tasks[3].completed = true; // Mark Task 4 as completed
-                taskDisplayed = false;
-            }
-        }
 
-        if (hiddenMapFound && !keyFound && isPlayerNearKey(camera.getCameraPosition(), keyPosition, 10.0f)) {
-            keyFound = true;  // Mark the key as found automatically
-            std::cout << "You found the key!" << std::endl;
-            std::cout << "The key has been picked up!" << std::endl; // No need for 'E', it's automatic
+            renderQueue.submit(RENDER_PASS_OPAQUE, shader, key, ModelMatrix); // Render the key (only visible after Hidden Map is found)
         }
 
-
-        if (beaconActivated) { // Helicopter position (adjust as needed)
+        if (state.beaconActivated) { // Helicopter position (adjust as needed)
 
             // Render the helicopter if the beacon is activated
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, helicopterPosition);
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.03f, .03f, .03f)); // Adjust size if needed
-            MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-            helicopter.draw(shader); // Render the helicopter
+            ModelMatrix = helicopterMatrix();
+
+            glm::vec3 helicopterCenter, helicopterExtent;
+            float helicopterRadius;
+            CullingSet::transform(helicopter, ModelMatrix, helicopterCenter, helicopterExtent, helicopterRadius);
+            lodSelector.select(helicopterLodState, helicopterLod, helicopterCenter, helicopterRadius, 0.03f);
+            submitLod(renderQueue, litShaders, 0, helicopter, helicopterLod, helicopterLodState,
+                ModelMatrix, helicopterPosition); // Render the helicopter
         }
 
-        if (beaconActivated && !escapeActivated && isPlayerNearBeacon(camera.getCameraPosition(), helicopterPosition, 70.0f)) {
-            if (window.isPressed(GLFW_KEY_E)) {
-                escapeActivated = true;  // Mark escape as triggered
-                std::cout << "Good job, you escaped!" << std::endl;  // Print message in the console
-            }
-        }
+        // Everything queued this frame, sorted by pass and state
+        renderQueue.execute(objectUniforms);
 
-        if (escapeActivated) {
+        if (state.escapeActivated) {
             // Fade the screen to black
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Set screen color to black
             window.clear();  // Clear the window to black
@@ -851,7 +1469,97 @@ int main()
             glfwSetWindowShouldClose(window.getWindow(), GL_TRUE);  // Close the window when the player escapes
         }
 
+        // F3 prints the shader and mesh LOD statistics of this frame, the geometry arena, mesh memory usage, GL state calls and culling
+        if (window.isPressed(GLFW_KEY_F3) && !lodReportKeyDown) {
+            shaderLod.printReport();
+            lodSelector.printReport();
+            treeImpostor.printReport();
+            jobs.printReport();
+            pipeline.printReport();
+            sceneryBatches.printReport();
+            renderQueue.printReport();
+            GeometryArena::printReport();
+            Mesh::printMemoryReport();
+            if (useIndirect)
+                indirect.printReport();
+            RingBuffer::printReport();
+            GLState::printReport();
+            CullingSet::printReport();
+            occlusion.printReport();
+            sunShadows.printReport();
+            sceneTree.printReport();
+            std::cout << "Frame time " << deltaTime * 1000.0f << " ms" << std::endl;
+        }
+        lodReportKeyDown = window.isPressed(GLFW_KEY_F3);
+
+        if (window.isPressed(GLFW_KEY_F5) && !occlusionBenchmarkKeyDown)
+            runOcclusionBenchmark(occlusion, ProjectionMatrix);
+        occlusionBenchmarkKeyDown = window.isPressed(GLFW_KEY_F5);
+
+        // F8 measures the threaded culling of the next frame's view on 1 up to every thread
+        if (window.isPressed(GLFW_KEY_F8) && !cullingScalingKeyDown)
+            cullingScalingRequested = true;
+        cullingScalingKeyDown = window.isPressed(GLFW_KEY_F8);
+
+        // F6 trades a frame of input latency for overlapping simulation and rendering, or back
+        if (window.isPressed(GLFW_KEY_F6) && !pipelineKeyDown) {
+            bool throughput = pipeline.getMode() == FRAME_PIPELINE_LATENCY;
+            pipeline.setMode(throughput ? FRAME_PIPELINE_THROUGHPUT : FRAME_PIPELINE_LATENCY);
+            std::cout << "Frame pipeline: " << (throughput ? "throughput" : "latency") << " mode" << std::endl;
+        }
+        pipelineKeyDown = window.isPressed(GLFW_KEY_F6);
+
+        // F7 redraws the static shadow casters every frame, for comparing against the cache
+        if (window.isPressed(GLFW_KEY_F7) && !shadowCacheKeyDown) {
+            sunShadows.caching = !sunShadows.caching;
+            std::cout << "Shadow cache " << (sunShadows.caching ? "on" : "off") << std::endl;
+        }
+        shadowCacheKeyDown = window.isPressed(GLFW_KEY_F7);
+
+        if (window.isPressed(GLFW_KEY_F4) && !forestKeyDown) {
+            if (forestPositions.empty()) {
+                std::vector<glm::mat4> forestMatrices;
+                buildForest(forestPositions, forestMatrices, forestSize);
+
+                // the instanced path streams only the visible trees
+                forestInstanceData.assign(forestMatrices.begin(), forestMatrices.end());
+                forestInstances.create(forestMatrices.size(), true);
+                for (const glm::vec3& position : forestPositions)
+                    forestImpostorData.push_back(InstanceData(glm::translate(glm::mat4(1.0f), position)));
+
+                if (useIndirect) {
+                    forestRecords = indirect.addStatic(tree_trunk, &forestMatrices[0], forestSize);
+                    indirect.addStatic(tree_crown, &forestMatrices[forestSize], forestSize);
+                }
+            }
+            forestEnabled = !forestEnabled;
+
+            // the trees never move, their leaves are only there while the forest is on
+            if (forestEnabled) {
+                for (int i = 0; i < forestSize * 2; ++i) {
+                    glm::vec3 center, extent;
+                    float radius;
+                    CullingSet::transform(i < forestSize ? tree_trunk : tree_crown, forestInstanceData[i].model,
+                        center, extent, radius);
+                    forestProxies.push_back(sceneTree.insert(center - extent, center + extent, SCENE_FOREST | i, 0.0f));
+                    forestLows.push_back(center - extent);
+                    forestHighs.push_back(center + extent);
+                }
+            }
+            else {
+                for (int proxy : forestProxies)
+                    sceneTree.remove(proxy);
+                forestProxies.clear();
+                forestLows.clear();
+                forestHighs.clear();
+            }
+            std::cout << "Benchmark forest " << (forestEnabled ? "on" : "off") << std::endl;
+        }
+        forestKeyDown = window.isPressed(GLFW_KEY_F4);
+
+        RingBuffer::endFrame();
         window.update();
+        pipeline.endFrame();
     }
 
     return 0;
@@ -865,27 +1573,27 @@ bool firstMouse = true;
 
 // ------------------------------------------------
 // KEYBOARD + Collision
-void processKeyboardInput()
+void processKeyboardInput(Camera& camera, const InputState& input)
 {
-    float cameraSpeed = 30.0f * deltaTime;
+    float cameraSpeed = 30.0f * input.deltaTime;
 
     // Store old position
     glm::vec3 oldPosition = camera.getCameraPosition();
 
     // Move the camera
-    if (window.isPressed(GLFW_KEY_LEFT_SHIFT) || window.isPressed(GLFW_KEY_RIGHT_SHIFT)) {
+    if (input.fast) {
         cameraSpeed *= 5.0f;
     }
-    if (window.isPressed(GLFW_KEY_W)) { camera.keyboardMoveFront(cameraSpeed); }
-    if (window.isPressed(GLFW_KEY_S)) { camera.keyboardMoveBack(cameraSpeed); }
-    if (window.isPressed(GLFW_KEY_A)) { camera.keyboardMoveLeft(cameraSpeed); }
-    if (window.isPressed(GLFW_KEY_D)) { camera.keyboardMoveRight(cameraSpeed); }
+    if (input.forward) { camera.keyboardMoveFront(cameraSpeed); }
+    if (input.back) { camera.keyboardMoveBack(cameraSpeed); }
+    if (input.left) { camera.keyboardMoveLeft(cameraSpeed); }
+    if (input.right) { camera.keyboardMoveRight(cameraSpeed); }
 
     // Jump logic
-    if (window.isPressed(GLFW_KEY_SPACE)) {
+    if (input.jump) {
         camera.startJump(25.0f);
     }
-    camera.updateJump(deltaTime);
+    camera.updateJump(input.deltaTime);
 
     // Collision checks
     glm::vec3 newPos = camera.getCameraPosition();
@@ -931,8 +1639,8 @@ void handleMouseInput()
     offsetX = offsetX * sensitivity;
     offsetY = offsetY * sensitivity;
 
-    camera.rotateOy((float)offsetX);
-    // camera.rotateOx((float)offsetY); // if needed
+    mouseYaw += (float)offsetX;
+    // mousePitch += (float)offsetY; // if needed
 
     // reset cursor
     glfwSetCursorPos(window.getWindow(), centerX, centerY);